@@ -0,0 +1,202 @@
+#include "CC1101SomfyTransmitter.h"
+
+#ifdef ESP32
+
+#include <ELECHOUSE_CC1101_SRC_DRV.h>
+#include <driver/gpio.h>
+
+// 24.99 kBaud with a 26 MHz crystal, a chip of 40 µs.
+#define CC1101_DRATE_E 9
+#define CC1101_DRATE_M 248
+#define CC1101_GDO_TX_FIFO_THRESHOLD 0x02
+#define CC1101_FIFO_THRESHOLD 7  // Signals a TX FIFO with less than 33 bytes, leaving 10 ms to refill it.
+#define CC1101_TXBYTES_UNDERFLOW 0x80
+#define CC1101_TXBYTES_COUNT 0x7F
+
+// While transmitting, the FIFO is also checked without a threshold interrupt, to notice it has drained.
+#define REFILL_POLL_INTERVAL_MS 5
+#define TASK_PRIORITY 10
+
+#define EVENT_IDLE BIT0
+#define EVENT_ROOM BIT1
+
+static const byte savedRegisterAddresses[] = {CC1101_IOCFG0,  CC1101_FIFOTHR, CC1101_PKTCTRL0,
+											  CC1101_MDMCFG4, CC1101_MDMCFG3, CC1101_MDMCFG2};
+
+CC1101SomfyTransmitter::CC1101SomfyTransmitter(byte thresholdPin)
+	: thresholdPin(thresholdPin),
+	  lock(nullptr),
+	  belowThreshold(nullptr),
+	  events(nullptr),
+	  savedRegisters(),
+	  open(false),
+	  doneCallback(nullptr),
+	  doneArg(nullptr) {}
+
+void CC1101SomfyTransmitter::setup() {
+	static_assert(sizeof(savedRegisterAddresses) == SAVED_REGISTER_COUNT, "Saved registers don't match");
+
+	lock = xSemaphoreCreateMutex();
+	belowThreshold = xSemaphoreCreateBinary();
+	events = xEventGroupCreate();
+	xEventGroupSetBits(events, EVENT_IDLE | EVENT_ROOM);
+
+	const gpio_num_t pin = static_cast<gpio_num_t>(thresholdPin);
+
+	ESP_ERROR_CHECK(gpio_set_direction(pin, GPIO_MODE_INPUT));
+	ESP_ERROR_CHECK(gpio_set_intr_type(pin, GPIO_INTR_NEGEDGE));
+
+	// The ISR service may already have been installed by someone else.
+	const esp_err_t err = gpio_install_isr_service(0);
+	if (err != ESP_ERR_INVALID_STATE) {
+		ESP_ERROR_CHECK(err);
+	}
+
+	ESP_ERROR_CHECK(gpio_isr_handler_add(pin, handleThreshold, this));
+	ESP_ERROR_CHECK(gpio_intr_disable(pin));
+
+	xTaskCreate([](void *arg) { static_cast<CC1101SomfyTransmitter *>(arg)->task(); }, "CC1101SomfyTransmitter",
+				4096, this, TASK_PRIORITY, nullptr);
+}
+
+void CC1101SomfyTransmitter::transmit(const SomfyPulseTrain &train) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+
+	open = true;
+
+	while (!encoder.push(train)) {
+		// Wait for the refill task to consume a queued train.
+		xEventGroupClearBits(events, EVENT_ROOM);
+		xSemaphoreGive(lock);
+		xEventGroupWaitBits(events, EVENT_ROOM, pdFALSE, pdTRUE, portMAX_DELAY);
+		xSemaphoreTake(lock, portMAX_DELAY);
+	}
+
+	if (xEventGroupGetBits(events) & EVENT_IDLE) {
+		start();
+	}
+
+	xSemaphoreGive(lock);
+}
+
+void CC1101SomfyTransmitter::flush() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+
+	if (open) {
+		open = false;
+
+		// The FIFO may have drained before the last train was queued; then finish has left the callback to us.
+		if ((xEventGroupGetBits(events) & EVENT_IDLE) && doneCallback) {
+			doneCallback(doneArg);
+		}
+	}
+
+	xSemaphoreGive(lock);
+}
+
+void CC1101SomfyTransmitter::wait() {
+	xEventGroupWaitBits(events, EVENT_IDLE, pdFALSE, pdTRUE, portMAX_DELAY);
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+	open = false;
+	xSemaphoreGive(lock);
+}
+
+void CC1101SomfyTransmitter::setDoneCallback(DoneCallback callback, void *arg) {
+	doneArg = arg;
+	doneCallback = callback;
+}
+
+void CC1101SomfyTransmitter::handleThreshold(void *arg) {
+	CC1101SomfyTransmitter *self = static_cast<CC1101SomfyTransmitter *>(arg);
+
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+	xSemaphoreGiveFromISR(self->belowThreshold, &higherPriorityTaskWoken);
+	if (higherPriorityTaskWoken) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+void CC1101SomfyTransmitter::task() {
+	while (true) {
+		const bool idle = xEventGroupGetBits(events) & EVENT_IDLE;
+		xSemaphoreTake(belowThreshold, idle ? portMAX_DELAY : pdMS_TO_TICKS(REFILL_POLL_INTERVAL_MS));
+
+		xSemaphoreTake(lock, portMAX_DELAY);
+		if (!(xEventGroupGetBits(events) & EVENT_IDLE) && !refill()) {
+			finish();
+		}
+		xSemaphoreGive(lock);
+	}
+}
+
+void CC1101SomfyTransmitter::start() {
+	ELECHOUSE_cc1101.setSidle();
+
+	for (byte i = 0; i < SAVED_REGISTER_COUNT; i++) {
+		savedRegisters[i] = ELECHOUSE_cc1101.SpiReadReg(savedRegisterAddresses[i]);
+	}
+
+	// Packet mode without preamble, sync word or CRC and an infinite packet length: the FIFO contents are sent as
+	// is until it runs empty. The modulation and receive bandwidth are kept.
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_IOCFG0, CC1101_GDO_TX_FIFO_THRESHOLD);
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_FIFOTHR, (savedRegisters[1] & 0xF0) | CC1101_FIFO_THRESHOLD);
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_PKTCTRL0, 0x02);
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_MDMCFG4, (savedRegisters[3] & 0xF0) | CC1101_DRATE_E);
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_MDMCFG3, CC1101_DRATE_M);
+	ELECHOUSE_cc1101.SpiWriteReg(CC1101_MDMCFG2, savedRegisters[5] & 0xF0);
+	ELECHOUSE_cc1101.SpiStrobe(CC1101_SFTX);
+
+	xEventGroupClearBits(events, EVENT_IDLE);
+
+	// Fill the FIFO before starting, so it doesn't underflow right away.
+	refill();
+	ELECHOUSE_cc1101.SpiStrobe(CC1101_STX);
+
+	ESP_ERROR_CHECK(gpio_intr_enable(static_cast<gpio_num_t>(thresholdPin)));
+	xSemaphoreGive(belowThreshold);
+}
+
+bool CC1101SomfyTransmitter::refill() {
+	const byte txBytes = ELECHOUSE_cc1101.SpiReadStatus(CC1101_TXBYTES);
+	if (txBytes & CC1101_TXBYTES_UNDERFLOW) {
+		if (!encoder.isEmpty()) {
+			Serial.println("CC1101 TX FIFO underflow");
+		}
+		return false;
+	}
+
+	byte buffer[FIFO_SIZE];
+	const byte queued = txBytes & CC1101_TXBYTES_COUNT;
+	const size_t read = encoder.read(buffer, FIFO_SIZE - queued, true);
+	if (read > 0) {
+		ELECHOUSE_cc1101.SpiWriteBurstReg(CC1101_TXFIFO, buffer, read);
+	}
+
+	if (!encoder.isFull()) {
+		xEventGroupSetBits(events, EVENT_ROOM);
+	}
+
+	// The transmission is done when everything has been clocked out.
+	return read > 0 || queued > 0;
+}
+
+void CC1101SomfyTransmitter::finish() {
+	ESP_ERROR_CHECK(gpio_intr_disable(static_cast<gpio_num_t>(thresholdPin)));
+
+	ELECHOUSE_cc1101.setSidle();
+	ELECHOUSE_cc1101.SpiStrobe(CC1101_SFTX);
+
+	for (byte i = 0; i < SAVED_REGISTER_COUNT; i++) {
+		ELECHOUSE_cc1101.SpiWriteReg(savedRegisterAddresses[i], savedRegisters[i]);
+	}
+
+	encoder.reset();
+	xEventGroupSetBits(events, EVENT_IDLE | EVENT_ROOM);
+
+	if (!open && doneCallback) {
+		doneCallback(doneArg);
+	}
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#ifdef ESP32
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+
+#include "SomfyChipEncoder.h"
+#include "SomfyTransmitter.h"
+
+/**
+ * Sends pulse trains through the TX FIFO of a CC1101. The trains are encoded into a chip stream that the radio
+ * clocks out in packet mode with an infinite packet length, so the radio does the timing. A task tops up the FIFO
+ * whenever it drains below the threshold, which the radio signals on GDO0.
+ *
+ * The radio is switched between its regular configuration and the FIFO configuration for every transmission, so
+ * it can be used for receiving in between.
+ *
+ * The transmitter drives the module that is selected in ELECHOUSE_cc1101, and accesses it from its own task while
+ * transmitting. Only use it with a single module.
+ */
+class CC1101SomfyTransmitter : public SomfyTransmitter {
+private:
+	static constexpr byte FIFO_SIZE = 64;
+	static constexpr byte SAVED_REGISTER_COUNT = 6;
+
+	byte thresholdPin;
+	SomfyChipEncoder encoder;
+	SemaphoreHandle_t lock;
+	SemaphoreHandle_t belowThreshold;
+	EventGroupHandle_t events;
+	byte savedRegisters[SAVED_REGISTER_COUNT];
+	// Whether trains are being queued for a transmission that hasn't been flushed yet.
+	bool open;
+	DoneCallback doneCallback;
+	void* doneArg;
+
+	static void handleThreshold(void* arg);
+	void task();
+	void start();
+	bool refill();
+	void finish();
+
+public:
+	CC1101SomfyTransmitter(byte thresholdPin);
+	void setup() override;
+	void transmit(const SomfyPulseTrain& train) override;
+	void flush() override;
+	void wait() override;
+	void setDoneCallback(DoneCallback callback, void* arg) override;
+};
+
+#endif
@@ -16,3 +16,8 @@ uint16_t EEPROMRollingCodeStorage::nextCode() {
 #endif
 	return code;
 }
+
+bool EEPROMRollingCodeStorage::peekCode(uint16_t &code) {
+	EEPROM.get(address, code);
+	return true;
+}
@@ -16,4 +16,5 @@ private:
 public:
 	EEPROMRollingCodeStorage(int address);
 	uint16_t nextCode() override;
+	bool peekCode(uint16_t &code) override;
 };
@@ -0,0 +1,81 @@
+#include "GPIOSomfyReceiver.h"
+
+#ifdef ESP32
+
+#include <driver/gpio.h>
+#include <esp_timer.h>
+
+GPIOSomfyReceiver::GPIOSomfyReceiver(byte receiverPin)
+	: receiverPin(receiverPin), head(0), tail(0), lastEdge(0), resynchronize(false) {}
+
+void GPIOSomfyReceiver::setup() {
+	const gpio_num_t pin = static_cast<gpio_num_t>(receiverPin);
+
+	ESP_ERROR_CHECK(gpio_set_direction(pin, GPIO_MODE_INPUT));
+	ESP_ERROR_CHECK(gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE));
+
+	// The ISR service may already have been installed by someone else.
+	const esp_err_t err = gpio_install_isr_service(0);
+	if (err != ESP_ERR_INVALID_STATE) {
+		ESP_ERROR_CHECK(err);
+	}
+
+	ESP_ERROR_CHECK(gpio_isr_handler_add(pin, handleEdge, this));
+}
+
+void GPIOSomfyReceiver::setEnabled(bool enabled) {
+	const gpio_num_t pin = static_cast<gpio_num_t>(receiverPin);
+
+	if (enabled) {
+		// The pulse that was in progress when capturing stopped is incomplete.
+		lastEdge = esp_timer_get_time();
+		resynchronize.store(true, std::memory_order_release);
+		ESP_ERROR_CHECK(gpio_intr_enable(pin));
+	} else {
+		ESP_ERROR_CHECK(gpio_intr_disable(pin));
+	}
+}
+
+void GPIOSomfyReceiver::handleEdge(void *arg) {
+	GPIOSomfyReceiver *self = static_cast<GPIOSomfyReceiver *>(arg);
+
+	const int64_t now = esp_timer_get_time();
+	const uint32_t duration = now - self->lastEdge;
+	self->lastEdge = now;
+
+	const uint32_t currentHead = self->head.load(std::memory_order_relaxed);
+	if (currentHead - self->tail.load(std::memory_order_acquire) >= CAPACITY) {
+		// Overflow; the decoder will resynchronize on the next frame.
+		return;
+	}
+
+	// The new level starts now, so the pulse that just ended had the opposite level.
+	const bool level = !gpio_get_level(static_cast<gpio_num_t>(self->receiverPin));
+	self->pulses[currentHead % CAPACITY] = (level ? LEVEL_MASK : 0) | (duration & ~LEVEL_MASK);
+	self->head.store(currentHead + 1, std::memory_order_release);
+}
+
+bool GPIOSomfyReceiver::poll(SomfyFrameContents &frame) {
+	const uint32_t currentHead = head.load(std::memory_order_acquire);
+	uint32_t currentTail = tail.load(std::memory_order_relaxed);
+
+	if (resynchronize.exchange(false, std::memory_order_acq_rel)) {
+		decoder.reset();
+	}
+
+	while (currentTail != currentHead) {
+		const uint32_t pulse = pulses[currentTail % CAPACITY];
+		currentTail++;
+
+		if (decoder.decode(pulse & LEVEL_MASK, pulse & ~LEVEL_MASK)) {
+			tail.store(currentTail, std::memory_order_release);
+			frame = decoder.getContents();
+			return true;
+		}
+	}
+
+	tail.store(currentTail, std::memory_order_release);
+	return false;
+}
+
+#endif
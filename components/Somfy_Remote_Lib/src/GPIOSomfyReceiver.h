@@ -0,0 +1,45 @@
+#pragma once
+
+#ifdef ESP32
+
+#include <atomic>
+
+#include "SomfyDecoder.h"
+
+/**
+ * Captures the demodulated signal of a receiver on a GPIO pin and decodes Somfy frames from it. Edges are
+ * timestamped in an interrupt handler and stored in a ring buffer; decoding happens in poll, outside of the
+ * interrupt.
+ */
+class GPIOSomfyReceiver {
+private:
+	static constexpr uint32_t CAPACITY = 512;  // Must be a power of two.
+	static constexpr uint32_t LEVEL_MASK = 0x80000000;
+
+	byte receiverPin;
+	uint32_t pulses[CAPACITY];
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+	int64_t lastEdge;
+	std::atomic<bool> resynchronize;
+	SomfyDecoder decoder;
+
+	static void handleEdge(void* arg);
+
+public:
+	GPIOSomfyReceiver(byte receiverPin);
+	void setup();
+	/**
+	 * Start or stop capturing edges, e.g. while the radio is transmitting.
+	 */
+	void setEnabled(bool enabled);
+	/**
+	 * Decode the pulses captured since the previous call.
+	 *
+	 * @param frame receives the frame when one was decoded
+	 * @return true when a frame was decoded; call again until it returns false to drain all captured pulses
+	 */
+	bool poll(SomfyFrameContents& frame);
+};
+
+#endif
@@ -2,50 +2,119 @@
 
 #ifdef ESP32
 
-#include <esp_system.h>
-#include <nvs.h>
-#include <nvs_flash.h>
+NVSRollingCodeStorage::NVSRollingCodeStorage(const char *name, const char *key, uint16_t blockSize)
+	: name(name), key(key), handle(0), ownsHandle(true), blockSize(blockSize > 0 ? blockSize : 1), loaded(false),
+	  next(0), reserved(0) {}
 
-NVSRollingCodeStorage::NVSRollingCodeStorage(const char *name, const char *key) : name(name), key(key) {}
+NVSRollingCodeStorage::NVSRollingCodeStorage(nvs_handle_t handle, const char *key, uint16_t blockSize)
+	: name(nullptr), key(key), handle(handle), ownsHandle(false), blockSize(blockSize > 0 ? blockSize : 1),
+	  loaded(false), next(0), reserved(0) {}
 
-uint16_t NVSRollingCodeStorage::nextCode() {
-	uint16_t code;
-	esp_err_t err;
-	nvs_handle rcs_handle;
+NVSRollingCodeStorage::~NVSRollingCodeStorage() {
+	if (ownsHandle && handle) {
+		nvs_close(handle);
+	}
+}
+
+bool NVSRollingCodeStorage::open() {
+	if (handle) {
+		return true;
+	}
+
+	const esp_err_t err = nvs_open(name, NVS_READWRITE, &handle);
+	if (err != ESP_OK) {
+		Serial.print("Error opening NVS namespace!");
+		Serial.println(esp_err_to_name(err));
+		handle = 0;
+		return false;
+	}
+
+	return true;
+}
+
+uint16_t NVSRollingCodeStorage::nextCode() { return reserveCodes(1); }
+
+uint16_t NVSRollingCodeStorage::reserveCodes(uint16_t count) {
+	uint16_t first;
+	if (!tryReserveCodes(count, first)) {
+		// Any code returned now could be handed out again after a restart.
+		abort();
+	}
+	return first;
+}
+
+bool NVSRollingCodeStorage::tryReserveCodes(uint16_t count, uint16_t &first) {
+	if (!loaded) {
+		// Everything from the stored code on hasn't been handed out yet, so the first block starts there.
+		uint16_t code;
+		if (!readCode(code)) {
+			return false;
+		}
+		next = reserved = code;
+		loaded = true;
+	}
+
+	// Persist the end of the block before handing out its first code, so a restart never reuses a code. A block is
+	// grown to hold all codes that are taken at once.
+	if (count > static_cast<uint16_t>(reserved - next)) {
+		const uint16_t end = next + (count > blockSize ? count : blockSize);
+		if (!writeCode(end)) {
+			return false;
+		}
+		reserved = end;
+	}
+
+	first = next;
+	next += count;
+	return true;
+}
 
-	// Initialize NVS
-	err = nvs_flash_init();
-	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-		// NVS partition was truncated and needs to be erased
-		// Retry nvs_flash_init
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		err = nvs_flash_init();
+bool NVSRollingCodeStorage::peekCode(uint16_t &code) {
+	if (loaded) {
+		code = next;
+		return true;
 	}
-	ESP_ERROR_CHECK(err);
 
-	err = nvs_open(name, NVS_READWRITE, &rcs_handle);
-	ESP_ERROR_CHECK(err);
+	return readCode(code);
+}
+
+bool NVSRollingCodeStorage::readCode(uint16_t &code) {
+	if (!open()) {
+		return false;
+	}
 
-	err = nvs_get_u16(rcs_handle, key, &code);
+	const esp_err_t err = nvs_get_u16(handle, key, &code);
 	switch (err) {
 		case ESP_OK:
-			break;
+			return true;
 		case ESP_ERR_NVS_NOT_FOUND:
+			// Nothing has been sent with this remote yet.
 			code = 1;
-			break;
+			return true;
 		default:
+			// Starting over would send codes the receiver has already seen.
 			Serial.print("Error reading!");
 			Serial.println(esp_err_to_name(err));
+			return false;
 	}
-	err = nvs_set_u16(rcs_handle, key, code + 1);
-#ifdef DEBUG
-	Serial.println((err != ESP_OK) ? "nvs_set failed!" : "nvs_set done");
-#endif
-	err = nvs_commit(rcs_handle);
-#ifdef DEBUG
-	Serial.println((err != ESP_OK) ? "nvs_commit failed!" : "nvs_commit done");
-#endif
-	return code;
+}
+
+bool NVSRollingCodeStorage::writeCode(uint16_t code) {
+	if (!open()) {
+		return false;
+	}
+
+	esp_err_t err = nvs_set_u16(handle, key, code);
+	if (err == ESP_OK) {
+		err = nvs_commit(handle);
+	}
+	if (err != ESP_OK) {
+		Serial.print("Error writing!");
+		Serial.println(esp_err_to_name(err));
+		return false;
+	}
+
+	return true;
 }
 
 #endif
@@ -2,19 +2,51 @@
 
 #ifdef ESP32
 
+#include <nvs.h>
+
 #include "RollingCodeStorage.h"
 
 /**
- * Stores the rolling codes in the NVS of an ESP32, the codes require two bytes.
+ * Stores the rolling codes in the NVS of an ESP32, the codes require two bytes. NVS must have been initialized with
+ * nvs_flash_init before the first code is requested.
+ *
+ * The NVS handle is opened on first use and kept open for the lifetime of the storage. Alternatively, a handle that
+ * is shared between multiple storages can be passed in; the caller then owns it and must keep it open.
+ *
+ * With a block size larger than one, a block of codes is reserved by storing the code following it, after which the
+ * codes of the block are handed out from memory. This reduces the flash writes by the block size, at the cost of
+ * skipping the unused codes of the block after a restart. The block size must stay well below the window of codes
+ * the receiver accepts, which is around 100 for Somfy motors.
+ *
+ * When the stored code can't be read or a block can't be stored, no codes are handed out. Only a missing code starts
+ * at 1. nextCode and reserveCodes can't report this and abort; use tryReserveCodes to handle it.
  */
 class NVSRollingCodeStorage : public RollingCodeStorage {
 private:
 	const char *name;
 	const char *key;
+	nvs_handle_t handle;
+	bool ownsHandle;
+	uint16_t blockSize;
+	bool loaded;
+	uint16_t next;
+	uint16_t reserved;
+
+	bool open();
+	bool readCode(uint16_t &code);
+	bool writeCode(uint16_t code);
 
 public:
-	NVSRollingCodeStorage(const char *name, const char *key);
+	NVSRollingCodeStorage(const char *name, const char *key, uint16_t blockSize = 1);
+	NVSRollingCodeStorage(nvs_handle_t handle, const char *key, uint16_t blockSize = 1);
+	~NVSRollingCodeStorage();
+	NVSRollingCodeStorage(const NVSRollingCodeStorage &) = delete;
+	NVSRollingCodeStorage &operator=(const NVSRollingCodeStorage &) = delete;
+
 	uint16_t nextCode() override;
+	bool peekCode(uint16_t &code) override;
+	uint16_t reserveCodes(uint16_t count) override;
+	bool tryReserveCodes(uint16_t count, uint16_t &first) override;
 };
 
 #endif
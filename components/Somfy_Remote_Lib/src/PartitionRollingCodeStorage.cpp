@@ -0,0 +1,462 @@
+#include "PartitionRollingCodeStorage.h"
+
+#ifdef ESP32
+
+#include <esp_rom_crc.h>
+
+#define LOG_MAGIC 0x4C435253  // "SRCL"
+#define SNAPSHOT_MAGIC 0x50414E53  // "SNAP", out of the range of remote IDs.
+#define SLOT_SIZE 8
+#define EMPTY_WORD 0xFFFFFFFF
+#define SLOT_CHUNK 32  // Slots read or written at once, to keep the stack usage down.
+
+/**
+ * Every sector starts with a header slot, followed by record slots. The snapshot records are followed by a marker
+ * slot once they're all written. A slot is written with a single write and is empty as long as all its bits are set.
+ */
+struct LogSlot {
+	uint32_t first;  // The magic for a header or marker, the remote for a record.
+	uint16_t second;  // The sequence number for a header or marker, the code for a record.
+	uint16_t crc;
+};
+
+static_assert(sizeof(LogSlot) == SLOT_SIZE, "Log slots must be 8 bytes");
+
+static uint16_t slotCrc(const LogSlot &slot) {
+	return esp_rom_crc16_le(0, reinterpret_cast<const uint8_t *>(&slot), offsetof(LogSlot, crc));
+}
+
+static LogSlot makeSlot(uint32_t first, uint16_t second) {
+	LogSlot slot = {first, second, 0};
+	slot.crc = slotCrc(slot);
+	return slot;
+}
+
+static bool isEmpty(const LogSlot &slot) {
+	const uint32_t *words = reinterpret_cast<const uint32_t *>(&slot);
+	return words[0] == EMPTY_WORD && words[1] == EMPTY_WORD;
+}
+
+PartitionRollingCodeLog::PartitionRollingCodeLog(const char *label)
+	: label(label), partition(nullptr), sectorCount(0), slotsPerSector(0), activeSector(0), position(0), sequence(0),
+	  entryCount(0) {
+	lock = xSemaphoreCreateMutex();
+}
+
+bool PartitionRollingCodeLog::begin() {
+	const esp_partition_t *found =
+		esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+	if (!found) {
+		Serial.print("Rolling code partition not found: ");
+		Serial.println(label);
+		return false;
+	}
+
+	// A sector must hold the header, a full snapshot with its marker and at least one record.
+	if (found->size / found->erase_size < 2 || found->erase_size / SLOT_SIZE < MAX_REMOTES + 3) {
+		Serial.println("Rolling code partition is too small");
+		return false;
+	}
+
+	xSemaphoreTake(lock, portMAX_DELAY);
+
+	partition = found;
+	sectorCount = partition->size / partition->erase_size;
+	slotsPerSector = partition->erase_size / SLOT_SIZE;
+	const bool result = scan();
+
+	xSemaphoreGive(lock);
+
+	return result;
+}
+
+bool PartitionRollingCodeLog::scan() {
+	// Sectors are started round-robin, so the sector with the highest sequence number is the active one.
+	bool found = false;
+	for (size_t sector = 0; sector < sectorCount; sector++) {
+		uint16_t sectorSequence;
+		if (readHeader(sector, sectorSequence) &&
+			(!found || static_cast<int16_t>(sectorSequence - sequence) > 0)) {
+			found = true;
+			activeSector = sector;
+			sequence = sectorSequence;
+		}
+	}
+
+	if (!found) {
+		return startSector(0, 0);
+	}
+
+	// Replay newest to oldest, taking the code of every remote from the newest sector that holds it. Every sector
+	// starts with a snapshot, so the older sectors are only needed when the snapshot of the newer one was cut short
+	// by a power loss. They may also hold remotes that were dropped since, which the snapshot left out.
+	bool complete = false;
+	size_t activeCount = 0;
+	for (size_t i = 0; i < sectorCount && !complete; i++) {
+		complete = replaySector((activeSector + sectorCount - i) % sectorCount, i == 0);
+		if (i == 0) {
+			if (complete) {
+				return true;
+			}
+			activeCount = entryCount;
+		}
+	}
+
+	// Starting the next sector erases the oldest one, which may be the last to hold the codes missing from the
+	// snapshot. Complete the active sector first, so it doesn't depend on the older sectors anymore.
+	for (size_t i = activeCount; i < entryCount; i++) {
+		if (position == slotsPerSector) {
+			return startNextSector();
+		}
+		if (!writeSlot(activeSector, position++, entries[i].remote, entries[i].code)) {
+			return true;
+		}
+	}
+	if (position == slotsPerSector) {
+		return startNextSector();
+	}
+	writeSlot(activeSector, position++, SNAPSHOT_MAGIC, sequence);
+
+	return true;
+}
+
+bool PartitionRollingCodeLog::contains(uint32_t remote) const {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	const bool result = find(remote) != nullptr;
+	xSemaphoreGive(lock);
+
+	return result;
+}
+
+uint16_t PartitionRollingCodeLog::get(uint32_t remote) const {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	const Entry *entry = find(remote);
+	const uint16_t code = entry ? entry->code : 1;
+	xSemaphoreGive(lock);
+
+	return code;
+}
+
+bool PartitionRollingCodeLog::put(uint32_t remote, uint16_t code) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	const bool result = putLocked(remote, code);
+	xSemaphoreGive(lock);
+
+	return result;
+}
+
+bool PartitionRollingCodeLog::advance(uint32_t remote, uint16_t count, uint16_t &first) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	const Entry *entry = findOrAdd(remote);
+	if (entry) {
+		first = entry->code;
+	}
+	const bool result = entry && putLocked(remote, first + count);
+	xSemaphoreGive(lock);
+
+	return result;
+}
+
+bool PartitionRollingCodeLog::stage(uint32_t remote, uint16_t count, uint16_t &first) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	Entry *entry = findOrAdd(remote);
+	if (entry) {
+		first = entry->code;
+		entry->code += count;
+		entry->dropped = false;
+		entry->pending = true;
+	}
+	xSemaphoreGive(lock);
+
+	return entry != nullptr;
+}
+
+bool PartitionRollingCodeLog::commit() {
+	xSemaphoreTake(lock, portMAX_DELAY);
+
+	size_t count = 0;
+	for (size_t i = 0; i < entryCount; i++) {
+		count += entries[i].pending;
+	}
+
+	bool result = true;
+	if (partition && count > 0) {
+		if (position + count > slotsPerSector) {
+			// The snapshot that starts the next sector includes the staged codes.
+			result = startNextSector();
+		} else {
+			LogSlot slots[SLOT_CHUNK];
+			size_t chunk = 0;
+			for (size_t i = 0; i < entryCount; i++) {
+				if (entries[i].pending) {
+					slots[chunk++] = makeSlot(entries[i].remote, entries[i].code);
+				}
+				if (chunk == SLOT_CHUNK || (chunk > 0 && i == entryCount - 1)) {
+					result &= writeSlots(activeSector, position, slots, chunk);
+					position += chunk;
+					chunk = 0;
+				}
+			}
+		}
+	}
+
+	// Codes that couldn't be written aren't used, and the next record or snapshot of the remote covers them.
+	for (size_t i = 0; i < entryCount; i++) {
+		entries[i].pending = false;
+	}
+
+	xSemaphoreGive(lock);
+
+	return result;
+}
+
+void PartitionRollingCodeLog::retain(const uint32_t *remotes, size_t count) {
+	xSemaphoreTake(lock, portMAX_DELAY);
+	for (size_t i = 0; i < entryCount; i++) {
+		bool listed = false;
+		for (size_t j = 0; j < count && !listed; j++) {
+			listed = entries[i].remote == remotes[j];
+		}
+		entries[i].dropped = !listed;
+	}
+	xSemaphoreGive(lock);
+}
+
+bool PartitionRollingCodeLog::putLocked(uint32_t remote, uint16_t code) {
+	Entry *entry = findOrAdd(remote);
+	if (!entry) {
+		return false;
+	}
+	// A code that couldn't be written is kept all the same. Skipping codes is harmless, reusing them isn't.
+	entry->code = code;
+	entry->dropped = false;
+
+	if (!partition) {
+		return true;
+	}
+
+	if (position < slotsPerSector) {
+		return writeSlot(activeSector, position++, remote, code);
+	}
+
+	// The snapshot that starts the next sector includes the new code.
+	return startNextSector();
+}
+
+PartitionRollingCodeLog::Entry *PartitionRollingCodeLog::find(uint32_t remote) {
+	for (size_t i = 0; i < entryCount; i++) {
+		if (entries[i].remote == remote) {
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+const PartitionRollingCodeLog::Entry *PartitionRollingCodeLog::find(uint32_t remote) const {
+	return const_cast<PartitionRollingCodeLog *>(this)->find(remote);
+}
+
+PartitionRollingCodeLog::Entry *PartitionRollingCodeLog::add(uint32_t remote) {
+	if (entryCount == MAX_REMOTES) {
+		return nullptr;
+	}
+
+	Entry *entry = &entries[entryCount++];
+	entry->remote = remote;
+	entry->code = 1;
+	entry->dropped = false;
+	entry->pending = false;
+	return entry;
+}
+
+PartitionRollingCodeLog::Entry *PartitionRollingCodeLog::findOrAdd(uint32_t remote) {
+	Entry *entry = find(remote);
+	if (entry) {
+		return entry;
+	}
+
+	// Starting the next sector frees the entries of the dropped remotes. A failure leaves the log as it was.
+	if (entryCount == MAX_REMOTES && partition && countDropped() > 0 && !startNextSector()) {
+		return nullptr;
+	}
+	entry = add(remote);
+	if (!entry) {
+		Serial.println("Too many remotes in rolling code log");
+	}
+	return entry;
+}
+
+size_t PartitionRollingCodeLog::countDropped() const {
+	size_t count = 0;
+	for (size_t i = 0; i < entryCount; i++) {
+		count += entries[i].dropped;
+	}
+	return count;
+}
+
+bool PartitionRollingCodeLog::readHeader(size_t sector, uint16_t &sequence) {
+	LogSlot slot;
+	if (esp_partition_read(partition, sector * partition->erase_size, &slot, sizeof(slot)) != ESP_OK) {
+		return false;
+	}
+	if (slot.first != LOG_MAGIC || slot.crc != slotCrc(slot)) {
+		return false;
+	}
+
+	sequence = slot.second;
+	return true;
+}
+
+bool PartitionRollingCodeLog::replaySector(size_t sector, bool active) {
+	uint16_t sectorSequence;
+	if (!readHeader(sector, sectorSequence)) {
+		return false;
+	}
+
+	// The remotes found so far come from newer sectors, which hold newer codes.
+	const size_t newer = entryCount;
+	bool complete = false;
+	LogSlot slots[SLOT_CHUNK];
+	size_t end = 1;
+
+	for (size_t slot = 1; slot < slotsPerSector; slot += SLOT_CHUNK) {
+		const size_t count = slotsPerSector - slot < SLOT_CHUNK ? slotsPerSector - slot : SLOT_CHUNK;
+		if (esp_partition_read(partition, sector * partition->erase_size + slot * SLOT_SIZE, slots,
+							   count * SLOT_SIZE) != ESP_OK) {
+			Serial.println("Error reading rolling code log");
+			break;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			if (isEmpty(slots[i])) {
+				continue;
+			}
+
+			// A torn slot can't be written again, so appending continues after it.
+			end = slot + i + 1;
+
+			if (slots[i].crc != slotCrc(slots[i])) {
+				continue;
+			}
+			if (slots[i].first == SNAPSHOT_MAGIC) {
+				complete |= slots[i].second == sectorSequence;
+				continue;
+			}
+
+			Entry *entry = find(slots[i].first);
+			if (!entry) {
+				entry = add(slots[i].first);
+			} else if (entry < entries + newer) {
+				continue;
+			}
+			if (entry) {
+				entry->code = slots[i].second;
+			}
+		}
+	}
+
+	if (active) {
+		position = end;
+	}
+	return complete;
+}
+
+bool PartitionRollingCodeLog::startNextSector() {
+	// The dropped remotes are left out of the snapshot, so their entries are free once it's started.
+	if (!startSector((activeSector + 1) % sectorCount, sequence + 1)) {
+		return false;
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < entryCount; i++) {
+		if (!entries[i].dropped) {
+			entries[kept++] = entries[i];
+		}
+	}
+	entryCount = kept;
+	return true;
+}
+
+bool PartitionRollingCodeLog::startSector(size_t sector, uint16_t sequence) {
+	const esp_err_t err = esp_partition_erase_range(partition, sector * partition->erase_size, partition->erase_size);
+	if (err != ESP_OK) {
+		Serial.print("Error erasing rolling code log!");
+		Serial.println(esp_err_to_name(err));
+		return false;
+	}
+
+	// The header goes first. Until the snapshot is complete, the previous sectors still hold the codes it's missing.
+	if (!writeSlot(sector, 0, LOG_MAGIC, sequence)) {
+		return false;
+	}
+
+	activeSector = sector;
+	this->sequence = sequence;
+	position = 1;
+
+	bool written = true;
+	for (size_t i = 0; i < entryCount; i++) {
+		if (!entries[i].dropped) {
+			written &= writeSlot(sector, position++, entries[i].remote, entries[i].code);
+		}
+	}
+
+	// Once the snapshot is marked complete, the older sectors are never read again.
+	if (!written || !writeSlot(sector, position++, SNAPSHOT_MAGIC, sequence)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < entryCount; i++) {
+		entries[i].pending = false;
+	}
+	return true;
+}
+
+bool PartitionRollingCodeLog::writeSlot(size_t sector, size_t slot, uint32_t first, uint16_t second) {
+	const LogSlot data = makeSlot(first, second);
+	return writeSlots(sector, slot, &data, 1);
+}
+
+bool PartitionRollingCodeLog::writeSlots(size_t sector, size_t slot, const LogSlot *slots, size_t count) {
+	const esp_err_t err = esp_partition_write(partition, sector * partition->erase_size + slot * SLOT_SIZE, slots,
+											  count * SLOT_SIZE);
+	if (err != ESP_OK) {
+		Serial.print("Error writing rolling code log!");
+		Serial.println(esp_err_to_name(err));
+		return false;
+	}
+
+	return true;
+}
+
+PartitionRollingCodeStorage::PartitionRollingCodeStorage(PartitionRollingCodeLog *log, uint32_t remote)
+	: log(log), remote(remote) {}
+
+uint16_t PartitionRollingCodeStorage::nextCode() { return reserveCodes(1); }
+
+bool PartitionRollingCodeStorage::peekCode(uint16_t &code) {
+	code = log->get(remote);
+	return true;
+}
+
+uint16_t PartitionRollingCodeStorage::reserveCodes(uint16_t count) {
+	uint16_t first;
+	if (!tryReserveCodes(count, first)) {
+		// Any code returned now could be handed out again after a restart.
+		abort();
+	}
+	return first;
+}
+
+bool PartitionRollingCodeStorage::tryReserveCodes(uint16_t count, uint16_t &first) {
+	return log->advance(remote, count, first);
+}
+
+bool PartitionRollingCodeStorage::tryReserveCodesInBatch(uint16_t count, uint16_t &first, RollingCodeBatch &batch) {
+	if (&batch != log) {
+		return tryReserveCodes(count, first);
+	}
+	return log->stage(remote, count, first);
+}
+
+#endif
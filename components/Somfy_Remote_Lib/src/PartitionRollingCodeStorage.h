@@ -0,0 +1,140 @@
+#pragma once
+
+#ifdef ESP32
+
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "RollingCodeStorage.h"
+
+struct LogSlot;
+
+/**
+ * Append-only log of the rolling codes of multiple remotes, stored in a dedicated data partition.
+ *
+ * Every code change appends one record to the active sector. When the active sector is full, the next sector is
+ * erased and starts with a snapshot of the codes of all remotes, so the older sectors are never needed again. The
+ * sectors are used round-robin, which spreads the erases evenly over the partition. Records and sector headers
+ * carry a CRC, so records torn by a power loss are ignored when the log is scanned in begin. A complete snapshot is
+ * marked as such. When a power loss cut the snapshot of the active sector short, begin appends the missing codes to
+ * it before an older sector holding them can be erased.
+ *
+ * The log holds up to MAX_REMOTES remotes. Remotes that are no longer used can be dropped with retain, which leaves
+ * them out of the snapshot that starts the next sector and frees their entries then.
+ *
+ * The log may be shared by tasks, e.g. the radio tasks sending commands and a flusher topping up reservations. All
+ * public methods are serialized by a mutex. As a batch, it appends the records of all codes staged by the flusher
+ * with a single write.
+ */
+class PartitionRollingCodeLog : public RollingCodeBatch {
+public:
+	static constexpr size_t MAX_REMOTES = 64;
+
+private:
+	struct Entry {
+		uint32_t remote;
+		uint16_t code;
+		// Left out of the next snapshot, after which the entry is freed.
+		bool dropped;
+		// Staged, but not written yet.
+		bool pending;
+	};
+
+	const char *label;
+	// Guards everything below; a put may be writing a record or starting a sector while another task reads.
+	SemaphoreHandle_t lock;
+	const esp_partition_t *partition;
+	size_t sectorCount;
+	size_t slotsPerSector;
+	size_t activeSector;
+	size_t position;
+	uint16_t sequence;
+	Entry entries[MAX_REMOTES];
+	size_t entryCount;
+
+	Entry *find(uint32_t remote);
+	const Entry *find(uint32_t remote) const;
+	Entry *add(uint32_t remote);
+	Entry *findOrAdd(uint32_t remote);
+	size_t countDropped() const;
+	bool scan();
+	bool readHeader(size_t sector, uint16_t &sequence);
+	bool replaySector(size_t sector, bool active);
+	bool startNextSector();
+	bool startSector(size_t sector, uint16_t sequence);
+	bool writeSlot(size_t sector, size_t slot, uint32_t first, uint16_t second);
+	bool writeSlots(size_t sector, size_t slot, const LogSlot *slots, size_t count);
+	bool putLocked(uint32_t remote, uint16_t code);
+
+public:
+	PartitionRollingCodeLog(const char *label);
+	/**
+	 * Find the partition and rebuild the codes by scanning the log, formatting the partition when it doesn't
+	 * contain a log yet.
+	 *
+	 * @return false when the partition doesn't exist or is too small
+	 */
+	bool begin();
+	bool contains(uint32_t remote) const;
+	/**
+	 * @return the stored code of the remote, or 1 when the remote isn't in the log
+	 */
+	uint16_t get(uint32_t remote) const;
+	/**
+	 * Store the code of a remote, adding the remote when it isn't in the log yet.
+	 *
+	 * @return false when the log is full or the code couldn't be written
+	 */
+	bool put(uint32_t remote, uint16_t code);
+	/**
+	 * Advance the code of a remote in one step, so two tasks can't get the same code. A remote that isn't in the
+	 * log starts at 1.
+	 *
+	 * @param remote the remote to advance the code of
+	 * @param count how far to advance the code
+	 * @param first receives the code before advancing it
+	 * @return false when the log is full or the code couldn't be written, in which case no code may be used
+	 */
+	bool advance(uint32_t remote, uint16_t count, uint16_t &first);
+	/**
+	 * Advance the code of a remote like advance, but leave writing it to the next commit.
+	 *
+	 * @return false when the log is full
+	 */
+	bool stage(uint32_t remote, uint16_t count, uint16_t &first);
+	/**
+	 * Write the codes staged since the last commit, in a single write when they fit in the active sector.
+	 */
+	bool commit() override;
+	/**
+	 * Drop all remotes that aren't listed. Their codes stay in the log until the next sector starts, which happens
+	 * right away when a new remote needs an entry. Dropped remotes that are used again are kept.
+	 *
+	 * Only remotes that can never be used again may be dropped: a dropped remote that's added again starts over
+	 * from the code it's added with.
+	 *
+	 * @param remotes the remotes to keep
+	 * @param count the number of remotes to keep
+	 */
+	void retain(const uint32_t *remotes, size_t count);
+};
+
+/**
+ * Stores the rolling code of one remote in a PartitionRollingCodeLog. Multiple remotes share a log.
+ */
+class PartitionRollingCodeStorage : public RollingCodeStorage {
+private:
+	PartitionRollingCodeLog *log;
+	uint32_t remote;
+
+public:
+	PartitionRollingCodeStorage(PartitionRollingCodeLog *log, uint32_t remote);
+	uint16_t nextCode() override;
+	bool peekCode(uint16_t &code) override;
+	uint16_t reserveCodes(uint16_t count) override;
+	bool tryReserveCodes(uint16_t count, uint16_t &first) override;
+	bool tryReserveCodesInBatch(uint16_t count, uint16_t &first, RollingCodeBatch &batch) override;
+};
+
+#endif
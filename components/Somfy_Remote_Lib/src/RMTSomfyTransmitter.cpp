@@ -0,0 +1,102 @@
+#include "RMTSomfyTransmitter.h"
+
+#ifdef ESP32
+
+#define RMT_RESOLUTION_HZ 1000000  // One tick per microsecond, the unit of SomfyPulse durations.
+// Enough for a short press to be queued completely, so sending one doesn't block on room in the queue. Longer
+// transmissions block in rmt_transmit until earlier trains have been sent.
+#define RMT_QUEUE_DEPTH 16
+
+static_assert(sizeof(rmt_symbol_word_t) == 2 * sizeof(SomfyPulse), "SomfyPulse must match an RMT half symbol");
+
+RMTSomfyTransmitter::RMTSomfyTransmitter(byte emitterPin)
+	: emitterPin(emitterPin),
+	  channel(nullptr),
+	  encoder(nullptr),
+	  pending(0),
+	  open(false),
+	  doneCallback(nullptr),
+	  doneArg(nullptr) {}
+
+void RMTSomfyTransmitter::setup() {
+	rmt_tx_channel_config_t channelConfig = {
+		.gpio_num = static_cast<gpio_num_t>(emitterPin),
+		.clk_src = RMT_CLK_SRC_DEFAULT,
+		.resolution_hz = RMT_RESOLUTION_HZ,
+		.mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+		.trans_queue_depth = RMT_QUEUE_DEPTH,
+	};
+	ESP_ERROR_CHECK(rmt_new_tx_channel(&channelConfig, &channel));
+
+	// The pulse trains are stored in the RMT symbol layout, so they can be copied verbatim.
+	rmt_copy_encoder_config_t encoderConfig = {};
+	ESP_ERROR_CHECK(rmt_new_copy_encoder(&encoderConfig, &encoder));
+
+	rmt_tx_event_callbacks_t callbacks = {
+		.on_trans_done = transmitDone,
+	};
+	ESP_ERROR_CHECK(rmt_tx_register_event_callbacks(channel, &callbacks, this));
+
+	ESP_ERROR_CHECK(rmt_enable(channel));
+}
+
+void RMTSomfyTransmitter::transmit(const SomfyPulseTrain &train) {
+	// An odd pulse would be paired with a zero duration, which the RMT interprets as the end of the transmission.
+	if (train.size() % 2 != 0) {
+		Serial.println("Pulse train is not aligned to RMT symbols");
+		return;
+	}
+
+	rmt_transmit_config_t transmitConfig = {};
+	transmitConfig.flags.eot_level = LOW;
+
+	// Hold back the done callback until the transmission is flushed; the queue may drain before the next train is
+	// queued.
+	if (!open) {
+		open = true;
+		pending++;
+	}
+
+	pending++;
+	ESP_ERROR_CHECK(rmt_transmit(channel, encoder, train.data(), train.size() * sizeof(SomfyPulse), &transmitConfig));
+}
+
+void RMTSomfyTransmitter::flush() {
+	if (!open) {
+		return;
+	}
+	open = false;
+
+	// When all trains have already been sent, the interrupt has left completing the transmission to us.
+	if (--pending == 0 && doneCallback) {
+		doneCallback(doneArg);
+	}
+}
+
+void RMTSomfyTransmitter::wait() {
+	ESP_ERROR_CHECK(rmt_tx_wait_all_done(channel, -1));
+
+	if (open) {
+		open = false;
+		pending--;
+	}
+}
+
+void RMTSomfyTransmitter::setDoneCallback(DoneCallback callback, void *arg) {
+	doneArg = arg;
+	doneCallback = callback;
+}
+
+bool IRAM_ATTR RMTSomfyTransmitter::transmitDone(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *event,
+												 void *arg) {
+	auto self = static_cast<RMTSomfyTransmitter *>(arg);
+
+	// Called once per train; only the last one of a flushed transmission completes it.
+	if (--self->pending > 0 || !self->doneCallback) {
+		return false;
+	}
+
+	return self->doneCallback(self->doneArg);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifdef ESP32
+
+#include <driver/rmt_tx.h>
+
+#include <atomic>
+
+#include "SomfyTransmitter.h"
+
+/**
+ * Sends pulse trains using the RMT peripheral of an ESP32. The peripheral clocks out the pulses, so the calling
+ * task is blocked only while waiting for room in the transmit queue or for the transmission to complete. The queue
+ * holds 16 trains, enough for a single command; longer transmissions, e.g. a SomfySession with several remotes,
+ * block in transmit until the queue has room again.
+ */
+class RMTSomfyTransmitter : public SomfyTransmitter {
+private:
+	byte emitterPin;
+	rmt_channel_handle_t channel;
+	rmt_encoder_handle_t encoder;
+	// The trains that haven't been sent yet, plus one while a transmission hasn't been flushed.
+	std::atomic<int> pending;
+	bool open;
+	DoneCallback doneCallback;
+	void *doneArg;
+
+	static bool transmitDone(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *event, void *arg);
+
+public:
+	RMTSomfyTransmitter(byte emitterPin);
+	void setup() override;
+	void transmit(const SomfyPulseTrain& train) override;
+	void flush() override;
+	void wait() override;
+	void setDoneCallback(DoneCallback callback, void *arg) override;
+};
+
+#endif
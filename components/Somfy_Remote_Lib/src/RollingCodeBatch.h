@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * A store shared by the rolling code storages of several remotes that can write the codes of all of them at once,
+ * e.g. a table of all remotes that's saved as a whole. Storages on the store hold the codes reserved into the batch
+ * in memory until it's committed.
+ */
+class RollingCodeBatch {
+public:
+	virtual ~RollingCodeBatch() = default;
+	/**
+	 * Write all codes reserved into the batch since the last commit. The codes may only be used once this succeeded.
+	 *
+	 * @return false when the codes couldn't be written
+	 */
+	virtual bool commit() = 0;
+};
@@ -2,6 +2,8 @@
 
 #include <Arduino.h>
 
+#include "RollingCodeBatch.h"
+
 class RollingCodeStorage {
 public:
 	/**
@@ -10,4 +12,47 @@ public:
 	 * @return next rolling code
 	 */
 	virtual uint16_t nextCode() = 0;
+	/**
+	 * Get the rolling code the next call to nextCode will return, without increasing it. SomfyRemote uses this to
+	 * render commands ahead of time. Implementations that can't tell return false, in which case commands are
+	 * rendered when they are sent.
+	 *
+	 * @param code receives the next rolling code
+	 * @return whether the next rolling code is known
+	 */
+	virtual bool peekCode(uint16_t &code) { return false; }
+	/**
+	 * Take a number of consecutive rolling codes from the store at once, like calling nextCode that many times.
+	 * Implementations can override this to store the increase with a single write.
+	 *
+	 * @return the first of the codes
+	 */
+	virtual uint16_t reserveCodes(uint16_t count) {
+		const uint16_t first = nextCode();
+		for (uint16_t i = 1; i < count; i++) {
+			nextCode();
+		}
+		return first;
+	}
+	/**
+	 * Take a number of consecutive rolling codes like reserveCodes, but fail when they can't be stored. Nothing may
+	 * be sent then, as the codes could be handed out again after a restart. SomfyRemote takes its codes this way.
+	 * Implementations that can fail override this; the default can't.
+	 *
+	 * @param count the number of codes to take
+	 * @param first receives the first of the codes
+	 * @return false when the codes couldn't be stored, in which case none were taken
+	 */
+	virtual bool tryReserveCodes(uint16_t count, uint16_t &first) {
+		first = reserveCodes(count);
+		return true;
+	}
+	/**
+	 * Take codes like tryReserveCodes, but leave writing them to a batch when the storage is on the store of the
+	 * batch. The codes may only be used once the batch was committed. Storages on another store write them right
+	 * away, which the default does.
+	 */
+	virtual bool tryReserveCodesInBatch(uint16_t count, uint16_t &first, RollingCodeBatch &batch) {
+		return tryReserveCodes(count, first);
+	}
 };
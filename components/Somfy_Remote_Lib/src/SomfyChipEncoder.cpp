@@ -0,0 +1,86 @@
+#include "SomfyChipEncoder.h"
+
+SomfyChipEncoder::SomfyChipEncoder() { reset(); }
+
+void SomfyChipEncoder::reset() {
+	head = 0;
+	count = 0;
+	pulseIndex = 0;
+	time = 0;
+	chips = 0;
+	remainingChips = 0;
+	level = LOW;
+	partial = 0;
+	partialChips = 0;
+}
+
+bool SomfyChipEncoder::push(const SomfyPulseTrain &train) {
+	if (isFull()) {
+		return false;
+	}
+
+	queue[(head + count) % QUEUE_SIZE] = &train;
+	count++;
+	return true;
+}
+
+bool SomfyChipEncoder::nextPulse() {
+	while (count > 0) {
+		const SomfyPulseTrain &train = *queue[head];
+		if (pulseIndex < train.size()) {
+			const SomfyPulse &pulse = train[pulseIndex++];
+
+			// The pulse ends on the chip boundary nearest to its nominal end. Padding from a flush may already
+			// have passed it, in which case the pulse is dropped.
+			time += pulse.duration;
+			const uint64_t endChip = (time + CHIP_DURATION / 2) / CHIP_DURATION;
+			remainingChips = endChip > chips ? endChip - chips : 0;
+			level = pulse.level;
+			return true;
+		}
+
+		head = (head + 1) % QUEUE_SIZE;
+		count--;
+		pulseIndex = 0;
+	}
+
+	return false;
+}
+
+size_t SomfyChipEncoder::read(byte *buffer, size_t size, bool flush) {
+	size_t read = 0;
+
+	while (read < size) {
+		if (remainingChips == 0 && !nextPulse()) {
+			break;
+		}
+
+		if (partialChips == 0 && remainingChips >= 8) {
+			// Whole bytes of the same level are the common case: syncs and silences.
+			buffer[read++] = level ? 0xFF : 0x00;
+			remainingChips -= 8;
+			chips += 8;
+			continue;
+		}
+
+		partial = (partial << 1) | level;
+		partialChips++;
+		remainingChips--;
+		chips++;
+
+		if (partialChips == 8) {
+			buffer[read++] = partial;
+			partial = 0;
+			partialChips = 0;
+		}
+	}
+
+	if (flush && partialChips > 0 && read < size) {
+		buffer[read++] = partial << (8 - partialChips);
+		chips += 8 - partialChips;
+		partial = 0;
+		partialChips = 0;
+	}
+
+	return read;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "SomfyPulseTrain.h"
+
+/**
+ * Converts pulse trains into a stream of fixed length chips for radios that clock out a bitstream from a FIFO. The
+ * chips are packed MSB first, a set bit meaning the output is high. Every edge is placed on the chip boundary
+ * nearest to its nominal time, so rounding errors don't accumulate over a transmission.
+ */
+class SomfyChipEncoder {
+public:
+	// A sixteenth of a Somfy symbol; the syncs and silences are rounded to a multiple of this.
+	static constexpr uint16_t CHIP_DURATION = 40;
+	static constexpr size_t QUEUE_SIZE = 16;
+
+private:
+	const SomfyPulseTrain* queue[QUEUE_SIZE];
+	size_t head;
+	size_t count;
+	size_t pulseIndex;
+	uint64_t time;
+	uint64_t chips;
+	uint32_t remainingChips;
+	bool level;
+	byte partial;
+	byte partialChips;
+
+	bool nextPulse();
+
+public:
+	SomfyChipEncoder();
+	void reset();
+	/**
+	 * Queue a pulse train. The train must stay valid until it has been read completely.
+	 *
+	 * @return false when the queue is full
+	 */
+	bool push(const SomfyPulseTrain& train);
+	bool isFull() const { return count == QUEUE_SIZE; }
+	/**
+	 * @return whether all queued trains have been read completely
+	 */
+	bool isEmpty() const { return count == 0 && remainingChips == 0 && partialChips == 0; }
+	/**
+	 * Read the next chips.
+	 *
+	 * @param buffer the buffer to read into
+	 * @param size the size of the buffer in bytes
+	 * @param flush whether to pad the last byte with low chips; otherwise incomplete bytes are kept until more
+	 * 				trains are queued
+	 * @return the number of bytes read
+	 */
+	size_t read(byte* buffer, size_t size, bool flush);
+};
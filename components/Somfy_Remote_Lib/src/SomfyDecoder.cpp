@@ -0,0 +1,101 @@
+#include "SomfyDecoder.h"
+
+#define SYMBOL 640
+
+#define IS_HALF_SYMBOL(d) ((d) >= SYMBOL / 2 && (d) < SYMBOL * 3 / 2)
+#define IS_SYMBOL(d) ((d) >= SYMBOL * 3 / 2 && (d) < SYMBOL * 5 / 2)
+#define IS_HARDWARE_SYNC(d) ((d) >= 3 * SYMBOL && (d) < 5 * SYMBOL)
+#define IS_SOFTWARE_SYNC(d) ((d) >= 3650 && (d) < 5450)
+
+#define DATA_HALF_SYMBOLS (SomfyFrame::SIZE * 8 * 2)
+
+SomfyDecoder::SomfyDecoder() { reset(); }
+
+void SomfyDecoder::reset() {
+	state = State::HardwareSync;
+	syncs = 0;
+	syncHigh = false;
+}
+
+bool SomfyDecoder::decode(bool level, uint32_t durationInMicroseconds) {
+	if (state == State::HardwareSync) {
+		return decodeSync(level, durationInMicroseconds);
+	}
+
+	byte units;
+	if (IS_HALF_SYMBOL(durationInMicroseconds)) {
+		units = 1;
+	} else if (IS_SYMBOL(durationInMicroseconds)) {
+		units = 2;
+	} else {
+		// Not part of a frame. The pulse may be the start of a new transmission.
+		reset();
+		return decodeSync(level, durationInMicroseconds);
+	}
+
+	// The software sync is followed by a low half symbol before the data starts.
+	if (gap) {
+		if (level) {
+			reset();
+			return decodeSync(level, durationInMicroseconds);
+		}
+		gap = false;
+		units--;
+	}
+
+	for (byte i = 0; i < units; i++) {
+		if (state != State::Data) {
+			break;
+		}
+		if (decodeHalfSymbol(level)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SomfyDecoder::decodeSync(bool level, uint32_t durationInMicroseconds) {
+	if (level && IS_HARDWARE_SYNC(durationInMicroseconds)) {
+		syncHigh = true;
+	} else if (!level && syncHigh && IS_HARDWARE_SYNC(durationInMicroseconds)) {
+		syncHigh = false;
+		if (syncs < 255) {
+			syncs++;
+		}
+	} else if (level && syncs >= 2 && IS_SOFTWARE_SYNC(durationInMicroseconds)) {
+		state = State::Data;
+		gap = true;
+		halfSymbols = 0;
+		frame = {};
+	} else {
+		syncs = 0;
+		syncHigh = false;
+	}
+
+	return false;
+}
+
+bool SomfyDecoder::decodeHalfSymbol(bool level) {
+	if (halfSymbols % 2 == 0) {
+		// A 1 bit is sent as low-high, a 0 bit as high-low, so the first half determines the bit.
+		firstHalf = level;
+		if (!level) {
+			const byte bit = halfSymbols / 2;
+			frame.data[bit / 8] |= 0x80 >> (bit % 8);
+		}
+	} else if (level == firstHalf) {
+		reset();
+		return false;
+	}
+
+	halfSymbols++;
+
+	// The second half of the last bit merges with the inter-frame silence, so don't wait for it.
+	if (halfSymbols == DATA_HALF_SYMBOLS - 1) {
+		reset();
+		return frame.decode(received);
+	}
+
+	return false;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "SomfyFrame.h"
+
+/**
+ * Streaming decoder for Somfy RTS transmissions. Pulses are fed one at a time as they are captured from the radio,
+ * decoding takes constant time per pulse. The decoder doesn't depend on any hardware, so it can also be fed from
+ * recorded edge timings.
+ */
+class SomfyDecoder {
+private:
+	enum class State : byte { HardwareSync, Data };
+
+	State state;
+	byte syncs;
+	bool syncHigh;
+	bool gap;
+	byte halfSymbols;
+	bool firstHalf;
+	SomfyFrame frame;
+	SomfyFrameContents received;
+
+	bool decodeSync(bool level, uint32_t durationInMicroseconds);
+	bool decodeHalfSymbol(bool level);
+
+public:
+	SomfyDecoder();
+	void reset();
+	/**
+	 * Feed the next pulse.
+	 *
+	 * @param level the level of the pulse
+	 * @param durationInMicroseconds how long the level was held
+	 * @return true when the pulse completed a valid frame, which is then available through getFrame and
+	 * 		   getContents
+	 */
+	bool decode(bool level, uint32_t durationInMicroseconds);
+	const SomfyFrame& getFrame() const { return frame; }
+	const SomfyFrameContents& getContents() const { return received; }
+};
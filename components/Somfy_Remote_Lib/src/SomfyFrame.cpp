@@ -0,0 +1,19 @@
+#include "SomfyFrame.h"
+
+void SomfyFrame::buildBatch(const SomfyFrameContents *requests, size_t count, SomfyFrame *frames) {
+	for (size_t i = 0; i < count; i++) {
+		frames[i] = fromWord(encode(requests[i].command, requests[i].code, requests[i].remote));
+	}
+}
+
+size_t SomfyFrame::decodeBatch(const SomfyFrame *frames, size_t count, SomfyFrameContents *contents, bool *valid) {
+	size_t validCount = 0;
+	for (size_t i = 0; i < count; i++) {
+		const bool frameValid = frames[i].decode(contents[i]);
+		if (valid) {
+			valid[i] = frameValid;
+		}
+		validCount += frameValid;
+	}
+	return validCount;
+}
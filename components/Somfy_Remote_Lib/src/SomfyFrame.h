@@ -0,0 +1,196 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum class Command : byte {
+	My = 0x1,
+	Up = 0x2,
+	MyUp = 0x3,
+	Down = 0x4,
+	MyDown = 0x5,
+	UpDown = 0x6,
+	Prog = 0x8,
+	SunFlag = 0x9,
+	Flag = 0xA
+};
+
+/**
+ * The contents of a frame: what it is built from, and what it decodes to.
+ */
+struct SomfyFrameContents {
+	Command command;
+	uint16_t code;
+	uint32_t remote;
+};
+
+/**
+ * An obfuscated 7 byte Somfy RTS frame as it is sent over the air.
+ */
+struct SomfyFrame {
+	static constexpr byte SIZE = 7;
+
+	byte data[SIZE];
+
+	constexpr byte operator[](byte index) const { return data[index]; }
+	constexpr bool operator==(const SomfyFrame& other) const {
+		for (byte i = 0; i < SIZE; i++) {
+			if (data[i] != other.data[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Build the frame for a command. This can be evaluated at compile time, e.g. to check the frames of fixed
+	 * remotes and commands with a static_assert.
+	 *
+	 * @param command the command to send
+	 * @param code the rolling code
+	 * @param remote the 24 bit remote address
+	 */
+	static constexpr SomfyFrame build(Command command, uint16_t code, uint32_t remote) {
+		const byte button = static_cast<byte>(command);
+
+		SomfyFrame frame = {};
+		frame.data[0] = 0xA7;          // Encryption key. Doesn't matter much
+		frame.data[1] = button << 4;   // Which button did  you press? The 4 LSB will be the checksum
+		frame.data[2] = code >> 8;     // Rolling code (big endian)
+		frame.data[3] = code;          // Rolling code
+		frame.data[4] = remote >> 16;  // Remote address
+		frame.data[5] = remote >> 8;   // Remote address
+		frame.data[6] = remote;        // Remote address
+
+		// Checksum calculation: a XOR of all the nibbles
+		byte checksum = 0;
+		for (byte i = 0; i < SIZE; i++) {
+			checksum = checksum ^ frame.data[i] ^ (frame.data[i] >> 4);
+		}
+		checksum &= 0b1111;  // We keep the last 4 bits only
+
+		// Checksum integration
+		frame.data[1] |= checksum;
+
+		// Obfuscation: a XOR of all the bytes
+		for (byte i = 1; i < SIZE; i++) {
+			frame.data[i] ^= frame.data[i - 1];
+		}
+
+		return frame;
+	}
+
+	/**
+	 * Word-parallel (SWAR) version of build. The frame is handled as a 56 bit word with the first byte in the most
+	 * significant position, so the nibble checksum and the chained XOR obfuscation each take a few shifts and XORs
+	 * instead of a loop over the bytes.
+	 *
+	 * @return the obfuscated frame as a big endian 56 bit word
+	 */
+	static constexpr uint64_t encode(Command command, uint16_t code, uint32_t remote) {
+		uint64_t word = (uint64_t(0xA7) << 48) | (uint64_t(static_cast<byte>(command) << 4) << 40) |
+						(uint64_t(code) << 24) | (remote & 0xFFFFFF);
+
+		// Fold all bytes onto the lowest one, then the high nibble onto the low one.
+		uint64_t checksum = word ^ (word >> 32);
+		checksum ^= checksum >> 16;
+		checksum ^= checksum >> 8;
+		checksum ^= checksum >> 4;
+		word |= (checksum & 0b1111) << 40;
+
+		// Prefix XOR: every byte becomes the XOR of itself and all bytes before it.
+		word ^= word >> 8;
+		word ^= word >> 16;
+		word ^= word >> 32;
+
+		return word;
+	}
+
+	static constexpr SomfyFrame fromWord(uint64_t word) {
+		SomfyFrame frame = {};
+		for (byte i = 0; i < SIZE; i++) {
+			frame.data[i] = word >> (8 * (SIZE - 1 - i));
+		}
+		return frame;
+	}
+
+	constexpr uint64_t toWord() const {
+		uint64_t word = 0;
+		for (byte i = 0; i < SIZE; i++) {
+			word = (word << 8) | data[i];
+		}
+		return word;
+	}
+
+	/**
+	 * Decode the frame, the inverse of build. The XOR chain is reversed and the checksum validated; the encryption
+	 * key in the first byte isn't checked because physical remotes vary it.
+	 *
+	 * @param contents receives the command, rolling code and remote address when the frame is valid
+	 * @return false when the checksum doesn't match
+	 */
+	constexpr bool decode(SomfyFrameContents& contents) const {
+		// Undo the prefix XOR: every byte is XORed with the obfuscated byte before it.
+		const uint64_t word = toWord();
+		const uint64_t plain = word ^ (word >> 8);
+
+		// The checksum makes the XOR of all nibbles zero.
+		uint64_t checksum = plain ^ (plain >> 32);
+		checksum ^= checksum >> 16;
+		checksum ^= checksum >> 8;
+		checksum ^= checksum >> 4;
+		if ((checksum & 0b1111) != 0) {
+			return false;
+		}
+
+		contents.command = static_cast<Command>((plain >> 44) & 0b1111);
+		contents.code = plain >> 24;
+		contents.remote = plain & 0xFFFFFF;
+
+		return true;
+	}
+
+	/**
+	 * Build a batch of frames into a contiguous buffer, e.g. when a scene moves many blinds at once. The result is
+	 * bit for bit identical to calling build for every request.
+	 *
+	 * @param requests the frames to build
+	 * @param count the number of requests
+	 * @param frames buffer receiving count frames
+	 */
+	static void buildBatch(const SomfyFrameContents* requests, size_t count, SomfyFrame* frames);
+	/**
+	 * Decode and validate a batch of frames, e.g. captured frames for offline analysis. Doesn't allocate.
+	 *
+	 * @param frames the frames to decode
+	 * @param count the number of frames
+	 * @param contents buffer receiving count decoded frames; entries of invalid frames are left untouched
+	 * @param valid optional buffer receiving for every frame whether its checksum matched
+	 * @return the number of valid frames
+	 */
+	static size_t decodeBatch(const SomfyFrame* frames, size_t count, SomfyFrameContents* contents, bool* valid);
+};
+
+static_assert(sizeof(SomfyFrame) == SomfyFrame::SIZE, "SomfyFrame batches must be contiguous");
+
+/**
+ * Manchester expansion of every byte value. Each entry holds the levels of the 16 half symbols of the byte, the
+ * first half symbol in the most significant bit. A 1 bit is sent as low-high, a 0 bit as high-low.
+ */
+struct SomfyManchesterTable {
+	uint16_t halfSymbols[256];
+
+	constexpr SomfyManchesterTable() : halfSymbols() {
+		for (int value = 0; value < 256; value++) {
+			uint16_t levels = 0;
+			for (int bit = 7; bit >= 0; bit--) {
+				levels <<= 2;
+				levels |= ((value >> bit) & 1) ? 0b01 : 0b10;
+			}
+			halfSymbols[value] = levels;
+		}
+	}
+
+	constexpr uint16_t operator[](byte value) const { return halfSymbols[value]; }
+};
+
+inline constexpr SomfyManchesterTable somfyManchester;
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+
+#ifdef ESP32
+#include <hal/gpio_ll.h>
+#endif
+
+#ifndef ARDUINO_ARCH_AVR
+#include <vector>
+#endif
+
+// Output policies for sending a transmission by toggling a pin in software. SomfyRemote::sendFrame takes the policy
+// as a template argument, so the writes to the pin are inlined into the loop generating the pulses. A policy sets
+// the level of the output and then keeps it for the duration of the pulse.
+
+/**
+ * Drives the pin using digitalWrite. Works on every Arduino platform.
+ */
+class SomfyDigitalWriteOutput {
+private:
+	byte pin;
+
+public:
+	explicit SomfyDigitalWriteOutput(byte pin) : pin(pin) {}
+
+	void setup() {
+		pinMode(pin, OUTPUT);
+		digitalWrite(pin, LOW);
+	}
+	void high(uint16_t durationInMicroseconds) {
+		digitalWrite(pin, HIGH);
+		delayMicroseconds(durationInMicroseconds);
+	}
+	void low(uint16_t durationInMicroseconds) {
+		digitalWrite(pin, LOW);
+		delayMicroseconds(durationInMicroseconds);
+	}
+	/**
+	 * Keep the current level for a longer time, allowing other tasks to run.
+	 */
+	void pause(uint32_t durationInMilliseconds) { delay(durationInMilliseconds); }
+};
+
+#ifdef ESP32
+
+/**
+ * Drives the pin by writing the GPIO set and clear registers directly (out_w1ts / out_w1tc), skipping the lookups
+ * digitalWrite does on every call.
+ */
+class SomfyGPIORegisterOutput {
+private:
+	byte pin;
+
+public:
+	explicit SomfyGPIORegisterOutput(byte pin) : pin(pin) {}
+
+	void setup() {
+		pinMode(pin, OUTPUT);
+		low(0);
+	}
+	void high(uint16_t durationInMicroseconds) {
+		gpio_ll_set_level(&GPIO, pin, 1);
+		delayMicroseconds(durationInMicroseconds);
+	}
+	void low(uint16_t durationInMicroseconds) {
+		gpio_ll_set_level(&GPIO, pin, 0);
+		delayMicroseconds(durationInMicroseconds);
+	}
+	void pause(uint32_t durationInMilliseconds) { delay(durationInMilliseconds); }
+};
+
+#endif
+
+#ifndef ARDUINO_ARCH_AVR
+
+/**
+ * Records the pulses instead of sending them, so the generated timing can be compared against the expected one
+ * without hardware.
+ */
+class SomfyRecorderOutput {
+public:
+	struct Pulse {
+		bool level;
+		uint32_t durationInMicroseconds;
+	};
+
+	std::vector<Pulse> pulses;
+
+	void setup() {}
+	void high(uint16_t durationInMicroseconds) { pulses.push_back({true, durationInMicroseconds}); }
+	void low(uint16_t durationInMicroseconds) { pulses.push_back({false, durationInMicroseconds}); }
+	void pause(uint32_t durationInMilliseconds) {
+		if (!pulses.empty()) {
+			pulses.back().durationInMicroseconds += durationInMilliseconds * 1000;
+		}
+	}
+};
+
+#endif
+
+/**
+ * The fastest output of the platform, used by SomfyRemote when it drives the pin itself.
+ */
+#ifdef ESP32
+typedef SomfyGPIORegisterOutput SomfyOutput;
+#else
+typedef SomfyDigitalWriteOutput SomfyOutput;
+#endif
@@ -0,0 +1,45 @@
+#include "SomfyPulseTrain.h"
+
+bool SomfyPulseTrain::append(bool level, uint32_t durationInMicroseconds) {
+	if (length > 0 && pulses[length - 1].level == level) {
+		const uint32_t room = MAX_DURATION - pulses[length - 1].duration;
+		const uint32_t merged = durationInMicroseconds < room ? durationInMicroseconds : room;
+		pulses[length - 1].duration += merged;
+		durationInMicroseconds -= merged;
+	}
+
+	while (durationInMicroseconds > 0 && length < CAPACITY) {
+		const uint32_t chunk = durationInMicroseconds < MAX_DURATION ? durationInMicroseconds : MAX_DURATION;
+		pulses[length].level = level;
+		pulses[length].duration = chunk;
+		length++;
+		durationInMicroseconds -= chunk;
+	}
+
+	return durationInMicroseconds == 0;
+}
+
+bool SomfyPulseTrain::alignToSymbols() {
+	if (length % 2 == 0) {
+		return true;
+	}
+	if (length >= CAPACITY) {
+		return false;
+	}
+
+	SomfyPulse& last = pulses[length - 1];
+	const uint16_t half = last.duration / 2;
+	pulses[length].level = last.level;
+	pulses[length].duration = last.duration - half;
+	last.duration = half;
+	length++;
+	return true;
+}
+
+uint32_t SomfyPulseTrain::duration() const {
+	uint32_t result = 0;
+	for (size_t i = 0; i < length; i++) {
+		result += pulses[i].duration;
+	}
+	return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * A single output level held for a duration in microseconds. The layout matches one half of an ESP32 RMT symbol, so
+ * a pulse train can be handed to the RMT peripheral as is.
+ */
+struct SomfyPulse {
+	uint16_t duration : 15;
+	uint16_t level : 1;
+};
+
+static_assert(sizeof(SomfyPulse) == 2, "SomfyPulse must match an RMT half symbol");
+
+/**
+ * Run-length encoded sequence of pulses making up (part of) a transmission. Consecutive pulses with the same level
+ * are merged, pulses longer than MAX_DURATION are split.
+ */
+class SomfyPulseTrain {
+public:
+	static constexpr size_t CAPACITY = 160;
+	static constexpr uint16_t MAX_DURATION = 0x7FFF;
+
+private:
+	SomfyPulse pulses[CAPACITY];
+	size_t length;
+
+public:
+	SomfyPulseTrain() : length(0) {}
+
+	void clear() { length = 0; }
+	/**
+	 * Append a level to the train, merging it with the previous pulse if that has the same level.
+	 *
+	 * @return false when the train is full and (part of) the level was dropped
+	 */
+	bool append(bool level, uint32_t durationInMicroseconds);
+	/**
+	 * Make sure the train consists of an even number of pulses by splitting the last one. Required before
+	 * handing the train to a backend that works with pairs of pulses.
+	 *
+	 * @return false when the train is full and couldn't be aligned
+	 */
+	bool alignToSymbols();
+
+	const SomfyPulse* data() const { return pulses; }
+	size_t size() const { return length; }
+	const SomfyPulse& operator[](size_t index) const { return pulses[index]; }
+	/**
+	 * @return the total airtime of the train in microseconds
+	 */
+	uint32_t duration() const;
+};
@@ -1,27 +1,274 @@
 #include "SomfyRemote.h"
 
 #define SYMBOL 640
+#define INTER_FRAME_GAP 30000
+
+static SomfyPulseKind getPulseKind(uint16_t durationInMicroseconds) {
+	switch (durationInMicroseconds) {
+		case SYMBOL:
+			return SomfyPulseKind::Symbol;
+		case 4 * SYMBOL:
+			return SomfyPulseKind::HardwareSync;
+		case 4550:
+			return SomfyPulseKind::SoftwareSync;
+		case 9415:
+		case 9565:
+			return SomfyPulseKind::WakeUp;
+		default:
+			return SomfyPulseKind::Silence;
+	}
+}
+
+/**
+ * Output policy recording the timing of the pulses sent through another policy.
+ */
+template <typename Output>
+class SomfyTimedOutput {
+private:
+	Output &output;
+	SomfyTimingStats &timingStats;
+
+public:
+	SomfyTimedOutput(Output &output, SomfyTimingStats &timingStats) : output(output), timingStats(timingStats) {}
+
+	void high(uint16_t durationInMicroseconds) {
+		timingStats.edge(getPulseKind(durationInMicroseconds), durationInMicroseconds);
+		output.high(durationInMicroseconds);
+	}
+	void low(uint16_t durationInMicroseconds) {
+		timingStats.edge(getPulseKind(durationInMicroseconds), durationInMicroseconds);
+		output.low(durationInMicroseconds);
+	}
+	void pause(uint32_t durationInMilliseconds) {
+		// The pause continues the level of the last pulse.
+		timingStats.extend(durationInMilliseconds * 1000);
+		output.pause(durationInMilliseconds);
+	}
+};
+
+static_assert(SomfyFrame::build(Command::Up, 42, 0x123456) == SomfyFrame{{0xA7, 0x87, 0x87, 0xAD, 0xBF, 0x8B, 0xDD}},
+			  "SomfyFrame::build doesn't match the reference frame");
+static_assert(SomfyFrame::fromWord(SomfyFrame::encode(Command::Up, 42, 0x123456)) ==
+				  SomfyFrame::build(Command::Up, 42, 0x123456),
+			  "SomfyFrame::encode doesn't match SomfyFrame::build");
+static_assert(
+	[] {
+		SomfyFrameContents contents = {};
+		return SomfyFrame::build(Command::Up, 42, 0x123456).decode(contents) && contents.command == Command::Up &&
+			   contents.code == 42 && contents.remote == 0x123456;
+	}(),
+	"SomfyFrame::decode isn't the inverse of SomfyFrame::build");
 
 SomfyRemote::SomfyRemote(byte emitterPin, uint32_t remote, RollingCodeStorage *rollingCodeStorage)
-	: emitterPin(emitterPin), remote(remote), rollingCodeStorage(rollingCodeStorage) {}
+	: output(emitterPin),
+	  transmitter(nullptr),
+	  remote(remote),
+	  rollingCodeStorage(rollingCodeStorage),
+	  renderedCommands(),
+	  timingStats(nullptr) {}
+
+SomfyRemote::SomfyRemote(SomfyTransmitter *transmitter, uint32_t remote, RollingCodeStorage *rollingCodeStorage)
+	: output(0),
+	  transmitter(transmitter),
+	  remote(remote),
+	  rollingCodeStorage(rollingCodeStorage),
+	  renderedCommands(),
+	  timingStats(nullptr) {}
+
+SomfyRemote::~SomfyRemote() {
+	for (byte i = 0; i < COMMAND_COUNT; i++) {
+		delete renderedCommands[i];
+	}
+}
 
 void SomfyRemote::setup() {
-	pinMode(emitterPin, OUTPUT);
-	digitalWrite(emitterPin, LOW);
+	if (transmitter) {
+		// The pin is owned by the transmitter.
+		return;
+	}
+	output.setup();
 }
 
-void SomfyRemote::sendCommand(Command command, int repeat) {
-	const uint16_t rollingCode = rollingCodeStorage->nextCode();
+bool SomfyRemote::sendCommand(Command command, int repeat) {
+	uint16_t rollingCode;
+	if (!takeCode(rollingCode)) {
+		return false;
+	}
+
 	sendCommandWithCode(command, rollingCode, repeat);
+	return true;
+}
+
+bool SomfyRemote::sendCommandAsync(Command command, int repeat) {
+	if (!transmitter) {
+		return sendCommand(command, repeat);
+	}
+
+	const SomfyRenderedCommand *rendered = renderNextCommand(command);
+	if (!rendered) {
+		return false;
+	}
+
+	transmitRendered(*rendered, repeat);
+	transmitter->flush();
+	return true;
 }
 
 void SomfyRemote::sendCommandWithCode(Command command, uint16_t rollingCode, int repeat) {
+	if (transmitter) {
+		transmitRendered(renderCommand(command, rollingCode), repeat);
+		transmitter->wait();
+		return;
+	}
+
 	byte frame[7];
 	buildFrame(frame, command, rollingCode);
+	if (timingStats) {
+		timingStats->begin();
+	}
 	sendFrame(frame, 2);
 	for (int i = 0; i < repeat; i++) {
 		sendFrame(frame, 7);
 	}
+	if (timingStats) {
+		timingStats->end();
+	}
+}
+
+bool SomfyRemote::holdCommand(Command command, uint32_t maxDurationInMilliseconds,
+							  const std::function<bool()> &isHeld) {
+	const unsigned long start = millis();
+	auto keepHolding = [&]() { return isHeld() && millis() - start < maxDurationInMilliseconds; };
+
+	if (transmitter) {
+		const SomfyRenderedCommand *rendered = renderNextCommand(command);
+		if (!rendered) {
+			return false;
+		}
+
+		transmitter->transmit(getWakeUp());
+		transmitter->transmit(rendered->firstFrame);
+		// Only a single frame is queued at a time, so a release takes effect at the next frame boundary.
+		transmitter->wait();
+		while (keepHolding()) {
+			transmitter->transmit(getInterFrameGap());
+			transmitter->transmit(rendered->repeatFrame);
+			transmitter->wait();
+		}
+		transmitter->transmit(getInterFrameGap());
+		transmitter->wait();
+		return true;
+	}
+
+	uint16_t rollingCode;
+	if (!takeCode(rollingCode)) {
+		return false;
+	}
+
+	byte frame[7];
+	buildFrame(frame, command, rollingCode);
+	if (timingStats) {
+		timingStats->begin();
+	}
+	sendFrame(frame, 2);
+	while (keepHolding()) {
+		sendFrame(frame, 7);
+	}
+	if (timingStats) {
+		timingStats->end();
+	}
+	return true;
+}
+
+void SomfyRemote::transmitRendered(const SomfyRenderedCommand &rendered, int repeat) {
+	transmitter->transmit(getWakeUp());
+	transmitter->transmit(rendered.firstFrame);
+	for (int i = 0; i < repeat; i++) {
+		transmitter->transmit(getInterFrameGap());
+		transmitter->transmit(rendered.repeatFrame);
+	}
+	transmitter->transmit(getInterFrameGap());
+}
+
+SomfyRenderedCommand &SomfyRemote::getRenderedCommand(Command command) {
+	const byte index = static_cast<byte>(command) % COMMAND_COUNT;
+
+	if (!renderedCommands[index]) {
+		renderedCommands[index] = new SomfyRenderedCommand();
+	}
+
+	return *renderedCommands[index];
+}
+
+bool SomfyRemote::renderCommand(SomfyRenderedCommand &rendered, const byte *frame, uint16_t rollingCode) {
+	// The trains are re-rendered in place; their buffers are reused for every rolling code.
+	const bool first = renderFrameBody(frame, 2, rendered.firstFrame);
+	const bool repeat = renderFrameBody(frame, 7, rendered.repeatFrame);
+	rendered.rollingCode = rollingCode;
+	if (!first || !repeat) {
+		Serial.println("Frame doesn't fit in a pulse train");
+		return false;
+	}
+	return true;
+}
+
+const SomfyRenderedCommand &SomfyRemote::renderCommand(Command command, uint16_t rollingCode) {
+	SomfyRenderedCommand &rendered = getRenderedCommand(command);
+
+	if (rendered.rollingCode != rollingCode || rendered.firstFrame.size() == 0) {
+		byte frame[SomfyFrame::SIZE];
+		buildFrame(frame, command, rollingCode);
+		renderCommand(rendered, frame, rollingCode);
+	}
+
+	return rendered;
+}
+
+const SomfyRenderedCommand *SomfyRemote::renderNextCommand(Command command) {
+	uint16_t rollingCode;
+	if (!takeCode(rollingCode)) {
+		return nullptr;
+	}
+
+	return &renderCommand(command, rollingCode);
+}
+
+bool SomfyRemote::takeCode(uint16_t &code) {
+	if (!rollingCodeStorage->tryReserveCodes(1, code)) {
+		Serial.println("Rolling code couldn't be stored, not sending");
+		return false;
+	}
+	return true;
+}
+
+void SomfyRemote::prepareCommand(Command command) {
+	uint16_t rollingCode;
+	if (rollingCodeStorage->peekCode(rollingCode)) {
+		renderCommand(command, rollingCode);
+	}
+}
+
+void SomfyRemote::prepare() {
+	uint16_t rollingCode;
+	if (!rollingCodeStorage->peekCode(rollingCode)) {
+		return;
+	}
+
+	// Encode the frames of all stale commands in one batch.
+	SomfyFrameContents requests[COMMAND_COUNT];
+	size_t count = 0;
+	for (byte i = 0; i < COMMAND_COUNT; i++) {
+		if (renderedCommands[i] && renderedCommands[i]->rollingCode != rollingCode) {
+			requests[count++] = {static_cast<Command>(i), rollingCode, remote};
+		}
+	}
+
+	SomfyFrame frames[COMMAND_COUNT];
+	SomfyFrame::buildBatch(requests, count, frames);
+
+	for (size_t i = 0; i < count; i++) {
+		renderCommand(getRenderedCommand(requests[i].command), frames[i].data, rollingCode);
+	}
 }
 
 void SomfyRemote::printFrame(byte *frame) {
@@ -36,100 +283,169 @@ void SomfyRemote::printFrame(byte *frame) {
 }
 
 void SomfyRemote::buildFrame(byte *frame, Command command, uint16_t code) {
-	const byte button = static_cast<byte>(command);
-	frame[0] = 0xA7;          // Encryption key. Doesn't matter much
-	frame[1] = button << 4;   // Which button did  you press? The 4 LSB will be the checksum
-	frame[2] = code >> 8;     // Rolling code (big endian)
-	frame[3] = code;          // Rolling code
-	frame[4] = remote >> 16;  // Remote address
-	frame[5] = remote >> 8;   // Remote address
-	frame[6] = remote;        // Remote address
+	const SomfyFrame built = SomfyFrame::build(command, code, remote);
+	memcpy(frame, built.data, SomfyFrame::SIZE);
 
 #ifdef DEBUG
-	Serial.print("Frame         : ");
+	Serial.print("Obfuscated    : ");
 	printFrame(frame);
 #endif
+}
 
-	// Checksum calculation: a XOR of all the nibbles
-	byte checksum = 0;
-	for (byte i = 0; i < 7; i++) {
-		checksum = checksum ^ frame[i] ^ (frame[i] >> 4);
+void SomfyRemote::sendFrame(const byte *frame, byte sync) {
+	// The measurements are kept out of the loop generating the pulses when they're disabled.
+	if (timingStats) {
+		SomfyTimedOutput<SomfyOutput> timedOutput(output, *timingStats);
+		sendFrame(timedOutput, frame, sync);
+	} else {
+		sendFrame(output, frame, sync);
 	}
-	checksum &= 0b1111;  // We keep the last 4 bits only
+}
 
-	// Checksum integration
-	frame[1] |= checksum;
+template <typename Output>
+void SomfyRemote::sendFrame(Output &output, const byte *frame, byte sync) {
+	if (sync == 2) {  // Only with the first frame.
+		// Wake-up pulse & Silence
+		output.high(9415);
+		output.low(9565);
+		output.pause(80);
+	}
 
-#ifdef DEBUG
-	Serial.print("With checksum : ");
-	printFrame(frame);
-#endif
+	// Hardware sync: two sync for the first frame, seven for the following ones.
+	for (int i = 0; i < sync; i++) {
+		output.high(4 * SYMBOL);
+		output.low(4 * SYMBOL);
+	}
 
-	// Obfuscation: a XOR of all the bytes
-	for (byte i = 1; i < 7; i++) {
-		frame[i] ^= frame[i - 1];
+	// Software sync
+	output.high(4550);
+	output.low(SYMBOL);
+
+	// Data: bytes are expanded into their half symbols using the Manchester table, starting with the MSB.
+	for (byte i = 0; i < SomfyFrame::SIZE; i++) {
+		const uint16_t halfSymbols = somfyManchester[frame[i]];
+		for (int8_t j = 15; j >= 0; j--) {
+			if ((halfSymbols >> j) & 1) {
+				output.high(SYMBOL);
+			} else {
+				output.low(SYMBOL);
+			}
+		}
 	}
 
-#ifdef DEBUG
-	Serial.print("Obfuscated    : ");
-	printFrame(frame);
-#endif
+	// Inter-frame silence
+	output.low(415);
+	output.pause(30);
 }
 
-void SomfyRemote::sendFrame(byte *frame, byte sync) {
+template void SomfyRemote::sendFrame(SomfyDigitalWriteOutput &output, const byte *frame, byte sync);
+#ifdef ESP32
+template void SomfyRemote::sendFrame(SomfyGPIORegisterOutput &output, const byte *frame, byte sync);
+#endif
+#ifndef ARDUINO_ARCH_AVR
+template void SomfyRemote::sendFrame(SomfyRecorderOutput &output, const byte *frame, byte sync);
+#endif
+
+bool SomfyRemote::renderFrame(const byte *frame, byte sync, SomfyPulseTrain &train) {
+	train.clear();
+	bool fits = true;
+
 	if (sync == 2) {  // Only with the first frame.
 		// Wake-up pulse & Silence
-		sendHigh(9415);
-		sendLow(9565);
-		delay(80);
+		fits &= train.append(HIGH, 9415);
+		fits &= train.append(LOW, 9565 + 80000);
+	}
+
+	SomfyPulseTrain body;
+	fits &= renderFrameBody(frame, sync, body);
+	for (size_t i = 0; i < body.size(); i++) {
+		fits &= train.append(body[i].level, body[i].duration);
 	}
 
+	// Inter-frame silence
+	fits &= train.append(LOW, INTER_FRAME_GAP);
+
+	fits &= train.alignToSymbols();
+
+	// A truncated frame must never be transmitted.
+	if (!fits) {
+		train.clear();
+	}
+	return fits;
+}
+
+bool SomfyRemote::renderFrameBody(const byte *frame, byte sync, SomfyPulseTrain &train) {
+	train.clear();
+	bool fits = true;
+
 	// Hardware sync: two sync for the first frame, seven for the following ones.
 	for (int i = 0; i < sync; i++) {
-		sendHigh(4 * SYMBOL);
-		sendLow(4 * SYMBOL);
+		fits &= train.append(HIGH, 4 * SYMBOL);
+		fits &= train.append(LOW, 4 * SYMBOL);
 	}
 
 	// Software sync
-	sendHigh(4550);
-	sendLow(SYMBOL);
-
-	// Data: bits are sent one by one, starting with the MSB.
-	for (byte i = 0; i < 56; i++) {
-		if (((frame[i / 8] >> (7 - (i % 8))) & 1) == 1) {
-			sendLow(SYMBOL);
-			sendHigh(SYMBOL);
-		} else {
-			sendHigh(SYMBOL);
-			sendLow(SYMBOL);
+	fits &= train.append(HIGH, 4550);
+	fits &= train.append(LOW, SYMBOL);
+
+	// Data: bytes are expanded into their half symbols using the Manchester table, starting with the MSB.
+	for (byte i = 0; i < SomfyFrame::SIZE; i++) {
+		const uint16_t halfSymbols = somfyManchester[frame[i]];
+		for (int8_t j = 15; j >= 0; j--) {
+			fits &= train.append((halfSymbols >> j) & 1, SYMBOL);
 		}
 	}
 
 	// Inter-frame silence
-	sendLow(415);
-	delay(30);
-}
-
-void SomfyRemote::sendHigh(uint16_t durationInMicroseconds) {
-#if defined(ESP32) || defined(ESP8266)
-	digitalWrite(emitterPin, HIGH);
-	delayMicroseconds(durationInMicroseconds);
-#elif defined(ARDUINO_ARCH_AVR)
-	// TODO fast write
-	digitalWrite(emitterPin, HIGH);
-	delayMicroseconds(durationInMicroseconds);
-#endif
+	fits &= train.append(LOW, 415);
+
+	fits &= train.alignToSymbols();
+
+	// A truncated frame must never be transmitted.
+	if (!fits) {
+		train.clear();
+	}
+	return fits;
 }
 
-void SomfyRemote::sendLow(uint16_t durationInMicroseconds) {
-#if defined(ESP32) || defined(ESP8266)
-	digitalWrite(emitterPin, LOW);
-	delayMicroseconds(durationInMicroseconds);
-#elif defined(ARDUINO_ARCH_AVR)
-	// TODO fast write
-	digitalWrite(emitterPin, LOW);
-	delayMicroseconds(durationInMicroseconds);
-#endif
+const SomfyPulseTrain &SomfyRemote::getWakeUp() {
+	static const SomfyPulseTrain wakeUp = [] {
+		SomfyPulseTrain train;
+		train.append(HIGH, 9415);
+		train.append(LOW, 9565 + 80000);
+		train.alignToSymbols();
+		return train;
+	}();
+	return wakeUp;
+}
+
+const SomfyPulseTrain &SomfyRemote::getInterFrameGap() {
+	static const SomfyPulseTrain gap = [] {
+		SomfyPulseTrain train;
+		train.append(LOW, INTER_FRAME_GAP);
+		train.alignToSymbols();
+		return train;
+	}();
+	return gap;
+}
+
+uint32_t SomfyRemote::getCommandDuration(int repeat) {
+	// The data is Manchester encoded, so the duration of a frame doesn't depend on its contents.
+	static const uint32_t firstFrame = [] {
+		const byte frame[SomfyFrame::SIZE] = {};
+		SomfyPulseTrain train;
+		renderFrameBody(frame, 2, train);
+		return train.duration();
+	}();
+	static const uint32_t repeatFrame = [] {
+		const byte frame[SomfyFrame::SIZE] = {};
+		SomfyPulseTrain train;
+		renderFrameBody(frame, 7, train);
+		return train.duration();
+	}();
+
+	const uint32_t gap = getInterFrameGap().duration();
+	return getWakeUp().duration() + firstFrame + repeat * (gap + repeatFrame) + gap;
 }
 
 Command getSomfyCommand(const String &string) {
@@ -2,47 +2,75 @@
 
 #include <Arduino.h>
 
+#include <functional>
+
 #include "RollingCodeStorage.h"
+#include "SomfyFrame.h"
+#include "SomfyOutput.h"
+#include "SomfyPulseTrain.h"
+#include "SomfyTimingStats.h"
+#include "SomfyTransmitter.h"
 
 #define SOMFY_MS_PER_ITER 165
 #define SOMFY_MS_TO_ITERS(ms) (((ms) + SOMFY_MS_PER_ITER - 1) / SOMFY_MS_PER_ITER)
 
-enum class Command : byte {
-	My = 0x1,
-	Up = 0x2,
-	MyUp = 0x3,
-	Down = 0x4,
-	MyDown = 0x5,
-	UpDown = 0x6,
-	Prog = 0x8,
-	SunFlag = 0x9,
-	Flag = 0xA
+/**
+ * The pulse trains of one command with one rolling code, ready to be transmitted. The trains contain the syncs and
+ * the data of a frame; the wake-up pulse and the inter-frame silence are sent as separate trains.
+ */
+struct SomfyRenderedCommand {
+	uint16_t rollingCode;
+	SomfyPulseTrain firstFrame;
+	SomfyPulseTrain repeatFrame;
 };
 
 class SomfyRemote {
 private:
-	byte emitterPin;
+	static constexpr byte COMMAND_COUNT = 16;
+
+	SomfyOutput output;
+	SomfyTransmitter* const transmitter;
 	uint32_t remote;
 	RollingCodeStorage* const rollingCodeStorage;
+	SomfyRenderedCommand* renderedCommands[COMMAND_COUNT];
+	SomfyTimingStats* timingStats;
 
 	void buildFrame(byte* frame, Command command, uint16_t code);
-	void sendFrame(byte* frame, byte sync);
+	bool takeCode(uint16_t& code);
+	SomfyRenderedCommand& getRenderedCommand(Command command);
+	static bool renderCommand(SomfyRenderedCommand& rendered, const byte* frame, uint16_t rollingCode);
+	void transmitRendered(const SomfyRenderedCommand& rendered, int repeat);
+	void sendFrame(const byte* frame, byte sync);
 	void printFrame(byte* frame);
 
-	void sendHigh(uint16_t durationInMicroseconds);
-	void sendLow(uint16_t durationInMicroseconds);
 
 public:
 	SomfyRemote(byte emitterPin, uint32_t remote, RollingCodeStorage* rollingCodeStorage);
+	/**
+	 * Create a SomfyRemote that renders its frames into pulse trains and sends them using a transmitter. The
+	 * transmitter may be shared between remotes and must be set up by the caller.
+	 */
+	SomfyRemote(SomfyTransmitter* transmitter, uint32_t remote, RollingCodeStorage* rollingCodeStorage);
+	SomfyRemote(const SomfyRemote&) = delete;
+	SomfyRemote& operator=(const SomfyRemote&) = delete;
+	~SomfyRemote();
 	void setup();
+	/**
+	 * Measure the timing of the pulses sent by sendCommand. Only applies when the remote drives the pin itself;
+	 * a transmitter times the pulses in hardware. The statistics may be shared between remotes.
+	 *
+	 * @param timingStats the statistics to record into, or nullptr to disable the measurements
+	 */
+	void setTimingStats(SomfyTimingStats* timingStats) { this->timingStats = timingStats; }
 	/**
 	 * Send a command with this SomfyRemote.
 	 *
 	 * @param command the command to send
 	 * @param repeat the number how often the command should be repeated, default 4. Should
 	 * 				 only be used when simulating holding a button.
+	 * @return false when the rolling code storage couldn't hand out a code, in which case nothing is sent
 	 */
-	void sendCommand(Command command, int repeat = 4);
+	bool sendCommand(Command command, int repeat = 4);
 	/**
 	 * Send a command with this SomfyRemote.
 	 *
@@ -52,6 +80,97 @@ public:
 	 * 				 only be used when simulating holding a button.
 	 */
 	void sendCommandWithCode(Command command, uint16_t rollingCode, int repeat = 4);
+	/**
+	 * Start sending a command and return without waiting for the transmission to complete. The completion is
+	 * reported through the done callback of the transmitter. The remote must not render the command again, e.g.
+	 * through prepare, until the transmission has completed. Without a transmitter, the command is sent before
+	 * returning.
+	 *
+	 * @param command the command to send
+	 * @param repeat the number how often the command should be repeated, default 4
+	 * @return false when the rolling code storage couldn't hand out a code, in which case nothing is sent and the
+	 * 		   done callback isn't called
+	 */
+	bool sendCommandAsync(Command command, int repeat = 4);
+	/**
+	 * Send a command for as long as a button is held. Frames are repeated until isHeld returns false or the maximum
+	 * duration has passed. isHeld is checked between frames, so the command stops within one frame of the button
+	 * being released.
+	 *
+	 * @param command the command to send
+	 * @param maxDurationInMilliseconds the maximum time the button is held
+	 * @param isHeld returns whether the button is still held
+	 * @return false when the rolling code storage couldn't hand out a code, in which case nothing is sent
+	 */
+	bool holdCommand(Command command, uint32_t maxDurationInMilliseconds, const std::function<bool()>& isHeld);
+	/**
+	 * Render a frame into a pulse train, including the wake-up pulse, the hardware and software syncs and the
+	 * inter-frame silence.
+	 *
+	 * @param frame the obfuscated 7 byte frame
+	 * @param sync the number of hardware syncs: 2 for the first frame, 7 for repeated frames
+	 * @param train the pulse train to render into
+	 * @return false when the frame doesn't fit in the train, which is left empty then
+	 */
+	static bool renderFrame(const byte* frame, byte sync, SomfyPulseTrain& train);
+	/**
+	 * Send a frame by toggling an output in software, including the wake-up pulse and the inter-frame silence.
+	 * Instantiated for the output policies in SomfyOutput.h.
+	 *
+	 * @param output the output policy to send the pulses with
+	 * @param frame the obfuscated 7 byte frame
+	 * @param sync the number of hardware syncs: 2 for the first frame, 7 for repeated frames
+	 */
+	template <typename Output>
+	static void sendFrame(Output& output, const byte* frame, byte sync);
+	/**
+	 * Render the body of a frame: the hardware and software syncs, the data and the short silence following it.
+	 *
+	 * @param frame the obfuscated 7 byte frame
+	 * @param sync the number of hardware syncs: 2 for the first frame, 7 for repeated frames
+	 * @param train the pulse train to render into
+	 * @return false when the frame doesn't fit in the train, which is left empty then
+	 */
+	static bool renderFrameBody(const byte* frame, byte sync, SomfyPulseTrain& train);
+	/**
+	 * @return the wake-up pulse and silence preceding the first frame of a transmission
+	 */
+	static const SomfyPulseTrain& getWakeUp();
+	/**
+	 * @return the silence between two frames of the same remote
+	 */
+	static const SomfyPulseTrain& getInterFrameGap();
+	/**
+	 * @param repeat the number how often the command is repeated
+	 * @return the airtime of a command sent with sendCommand in microseconds
+	 */
+	static uint32_t getCommandDuration(int repeat = 4);
+	/**
+	 * Get the pulse trains for a command. The trains are cached per command and only rendered again when the
+	 * rolling code differs from the one they were rendered for.
+	 *
+	 * @param command the command to render
+	 * @param rollingCode the rolling code to render the command with
+	 * @return the rendered pulse trains, valid until the command is rendered again
+	 */
+	const SomfyRenderedCommand& renderCommand(Command command, uint16_t rollingCode);
+	/**
+	 * Get the pulse trains for a command with the next rolling code. This consumes the rolling code; the trains are
+	 * valid until the command is rendered again, which happens at the earliest on the next call to prepare.
+	 *
+	 * @return the rendered pulse trains, or nullptr when the rolling code storage couldn't hand out a code
+	 */
+	const SomfyRenderedCommand* renderNextCommand(Command command);
+	/**
+	 * Render a command for the next rolling code, so a following sendCommand doesn't have to encode anything.
+	 * The command is kept up to date by prepare from then on. Does nothing if the rolling code storage can't peek.
+	 */
+	void prepareCommand(Command command);
+	/**
+	 * Render all cached commands for the next rolling code. Should be called when the transmitter is idle, e.g.
+	 * after a command has been sent.
+	 */
+	void prepare();
 };
 
 Command getSomfyCommand(const String& string);
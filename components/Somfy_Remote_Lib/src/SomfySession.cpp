@@ -0,0 +1,79 @@
+#include "SomfySession.h"
+
+SomfySession::SomfySession(SomfyTransmitter *transmitter, uint32_t gapInMicroseconds)
+	: transmitter(transmitter), count(0) {
+	gap.append(LOW, gapInMicroseconds);
+	gap.alignToSymbols();
+}
+
+bool SomfySession::add(SomfyRemote &remote, Command command, int repeat) {
+	// The rendered trains are owned by the remote, so a second command would overwrite the first.
+	if (count >= CAPACITY || contains(remote)) {
+		return false;
+	}
+
+	const SomfyRenderedCommand *rendered = remote.renderNextCommand(command);
+	if (!rendered) {
+		return false;
+	}
+
+	entries[count++] = {&remote, rendered, repeat};
+	return true;
+}
+
+bool SomfySession::contains(const SomfyRemote &remote) const {
+	for (size_t i = 0; i < count; i++) {
+		if (entries[i].remote == &remote) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void SomfySession::send() {
+	if (count == 0) {
+		return;
+	}
+
+	start();
+	transmitter->wait();
+}
+
+void SomfySession::start() {
+	if (count == 0) {
+		return;
+	}
+
+	transmitter->transmit(SomfyRemote::getWakeUp());
+
+	// Every round sends one frame of every remote that has frames left: the first frame in round 0 and the
+	// repeated frames after that.
+	const Entry *previous = nullptr;
+	for (int round = 0;; round++) {
+		bool sent = false;
+
+		for (size_t i = 0; i < count; i++) {
+			const Entry &entry = entries[i];
+			if (round > entry.repeat) {
+				continue;
+			}
+
+			if (previous) {
+				transmitter->transmit(previous == &entry ? SomfyRemote::getInterFrameGap() : gap);
+			}
+			transmitter->transmit(round == 0 ? entry.rendered->firstFrame : entry.rendered->repeatFrame);
+
+			previous = &entry;
+			sent = true;
+		}
+
+		if (!sent) {
+			break;
+		}
+	}
+
+	transmitter->transmit(SomfyRemote::getInterFrameGap());
+	transmitter->flush();
+
+	count = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "SomfyRemote.h"
+
+/**
+ * Sends commands for several remotes in one transmission. The wake-up pulse is sent once, after which the frames
+ * of the remotes are interleaved. Consecutive frames of different remotes are only separated by a short gap; the
+ * frames of a single remote are still spaced by at least the regular inter-frame silence.
+ */
+class SomfySession {
+public:
+	static constexpr size_t CAPACITY = 16;
+
+private:
+	struct Entry {
+		SomfyRemote* remote;
+		const SomfyRenderedCommand* rendered;
+		int repeat;
+	};
+
+	SomfyTransmitter* const transmitter;
+	SomfyPulseTrain gap;
+	Entry entries[CAPACITY];
+	size_t count;
+
+public:
+	/**
+	 * @param transmitter the transmitter shared by the remotes
+	 * @param gapInMicroseconds the silence between frames of different remotes
+	 */
+	SomfySession(SomfyTransmitter* transmitter, uint32_t gapInMicroseconds);
+	/**
+	 * Add a command to the session. This consumes a rolling code of the remote.
+	 *
+	 * @param remote the remote to send the command with; must use the transmitter of the session
+	 * @param command the command to send
+	 * @param repeat the number how often the command should be repeated
+	 * @return false when the session is full, already has a command for the remote or the rolling code storage of
+	 * 		   the remote couldn't hand out a code
+	 */
+	bool add(SomfyRemote& remote, Command command, int repeat = 4);
+	bool contains(const SomfyRemote& remote) const;
+	size_t size() const { return count; }
+	/**
+	 * Send all commands and wait for the transmission to complete. The session is empty afterwards.
+	 */
+	void send();
+	/**
+	 * Start sending all commands without waiting for the transmission to complete. The completion is reported
+	 * through the done callback of the transmitter. The session is empty afterwards, but must not be destroyed
+	 * until the transmission has completed.
+	 *
+	 * The trains are queued with the transmitter before returning. A session of more than one remote doesn't fit
+	 * in the queue of the RMT transmitter, so this blocks until the last trains could be queued, which is a few
+	 * frames before the end of the transmission.
+	 */
+	void start();
+};
@@ -0,0 +1,77 @@
+#include "SomfyTimingStats.h"
+
+#ifdef ESP32
+#include <esp_timer.h>
+#endif
+
+static int64_t getTime() {
+#ifdef ESP32
+	return esp_timer_get_time();
+#else
+	return micros();
+#endif
+}
+
+uint32_t SomfyTimingStats::Histogram::getPercentile(byte percentile) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	// The rank of the percentile, rounded up, so the 100th percentile is the last error.
+	const uint32_t rank = (static_cast<uint64_t>(count) * percentile + 99) / 100;
+	uint32_t seen = 0;
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		seen += buckets[i];
+		if (seen >= rank && seen > 0) {
+			const uint32_t bound = (i + 1) * BUCKET_WIDTH - 1;
+			return bound < max ? bound : max;
+		}
+	}
+	return max;
+}
+
+SomfyTimingStats::SomfyTimingStats() { reset(); }
+
+void SomfyTimingStats::begin() { running = false; }
+
+void SomfyTimingStats::edge(SomfyPulseKind kind, uint32_t durationInMicroseconds) {
+	const int64_t now = getTime();
+
+	if (running) {
+		record(now);
+	}
+
+	lastEdge = now;
+	plannedDuration = durationInMicroseconds;
+	lastKind = kind;
+	running = true;
+}
+
+void SomfyTimingStats::end() {
+	if (running) {
+		record(getTime());
+	}
+
+	running = false;
+}
+
+void SomfyTimingStats::record(int64_t now) {
+	const int64_t difference = now - lastEdge - plannedDuration;
+	const uint32_t error = difference < 0 ? -difference : difference;
+
+	Histogram &histogram = histograms[static_cast<byte>(lastKind)];
+	const size_t bucket = error / BUCKET_WIDTH;
+	histogram.buckets[bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1]++;
+	histogram.count++;
+	if (error > histogram.max) {
+		histogram.max = error;
+	}
+}
+
+void SomfyTimingStats::reset() {
+	memset(histograms, 0, sizeof(histograms));
+	lastEdge = 0;
+	plannedDuration = 0;
+	lastKind = SomfyPulseKind::Silence;
+	running = false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * The kinds of pulses making up a transmission. Timing errors are tracked per kind, because they are generated by
+ * different mechanisms: the data and syncs by busy waiting, the long silences partly by the scheduler tick.
+ */
+enum class SomfyPulseKind : byte { Symbol, HardwareSync, SoftwareSync, WakeUp, Silence };
+
+/**
+ * Histograms of the difference between the nominal and the actual duration of transmitted pulses. Every edge is
+ * timestamped when it is generated, so the error of a pulse includes everything that delays the next edge, e.g.
+ * the write to the pin, interrupts and task switches.
+ */
+class SomfyTimingStats {
+public:
+	static constexpr byte KIND_COUNT = 5;
+	static constexpr uint16_t BUCKET_WIDTH = 4;
+	static constexpr size_t BUCKET_COUNT = 128;
+
+	/**
+	 * Histogram of absolute errors in microseconds. Errors beyond the last bucket are counted in the last bucket;
+	 * the maximum is tracked exactly.
+	 */
+	struct Histogram {
+		uint32_t buckets[BUCKET_COUNT];
+		uint32_t count;
+		uint32_t max;
+
+		/**
+		 * @param percentile the percentile to get, 0 to 100
+		 * @return the upper bound of the bucket containing the percentile, at most max
+		 */
+		uint32_t getPercentile(byte percentile) const;
+	};
+
+private:
+	Histogram histograms[KIND_COUNT];
+	int64_t lastEdge;
+	uint32_t plannedDuration;
+	SomfyPulseKind lastKind;
+	bool running;
+
+	void record(int64_t now);
+
+public:
+	SomfyTimingStats();
+	/**
+	 * Start a transmission. The first edge after this isn't measured against anything.
+	 */
+	void begin();
+	/**
+	 * Record an edge that is about to be generated.
+	 *
+	 * @param kind the kind of the pulse starting at this edge
+	 * @param durationInMicroseconds the nominal duration of the pulse starting at this edge
+	 */
+	void edge(SomfyPulseKind kind, uint32_t durationInMicroseconds);
+	/**
+	 * Extend the nominal duration of the current pulse, e.g. when a silence is continued with a delay.
+	 */
+	void extend(uint32_t durationInMicroseconds) { plannedDuration += durationInMicroseconds; }
+	/**
+	 * End a transmission, recording the error of the last pulse.
+	 */
+	void end();
+	void reset();
+	const Histogram& getHistogram(SomfyPulseKind kind) const { return histograms[static_cast<byte>(kind)]; }
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "SomfyPulseTrain.h"
+
+/**
+ * Puts rendered pulse trains on the air. Implementations may return from transmit before the train has been sent
+ * completely, so the train must stay valid until wait returns.
+ */
+class SomfyTransmitter {
+public:
+	/**
+	 * Called when all pulse trains of a flushed transmission have been sent. May be called from an interrupt, or
+	 * from the task calling flush when the trains had already been sent by then.
+	 *
+	 * @return whether a higher priority task has been woken
+	 */
+	typedef bool (*DoneCallback)(void *arg);
+
+	virtual void setup() = 0;
+	/**
+	 * Queue a pulse train for transmission. Trains are sent back to back in the order they were queued. Blocks
+	 * while the queue of the transmitter is full, so queuing a long transmission returns only once its first trains
+	 * have been sent.
+	 *
+	 * @param train the pulse train to send
+	 */
+	virtual void transmit(const SomfyPulseTrain& train) = 0;
+	/**
+	 * Mark the end of a transmission after its last train has been queued. The done callback isn't called before
+	 * that, even when the queue runs empty while the caller is still queuing trains.
+	 */
+	virtual void flush() {}
+	/**
+	 * Wait until all queued pulse trains have been sent. Ends the transmission like flush does, without calling the
+	 * done callback.
+	 */
+	virtual void wait() = 0;
+	/**
+	 * Set the callback that is called when all queued pulse trains have been sent. Allows the caller to do other
+	 * work while a transmission is on the air instead of blocking in wait.
+	 */
+	virtual void setDoneCallback(DoneCallback callback, void *arg) = 0;
+};
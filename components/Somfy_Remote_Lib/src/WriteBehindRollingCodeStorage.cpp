@@ -0,0 +1,153 @@
+#include "WriteBehindRollingCodeStorage.h"
+
+#ifdef ESP32
+
+RollingCodeFlusher::RollingCodeFlusher(uint32_t idleMs, RollingCodeBatch *batch)
+	: idleMs(idleMs), batch(batch), taskHandle(nullptr), storageCount(0) {}
+
+void RollingCodeFlusher::begin(UBaseType_t priority) {
+	xTaskCreate([](void *arg) { static_cast<RollingCodeFlusher *>(arg)->task(); }, "RollingCodeFlusher", 4096, this,
+				priority, &taskHandle);
+}
+
+void RollingCodeFlusher::add(WriteBehindRollingCodeStorage *storage) {
+	const size_t index = storageCount;
+	if (index == MAX_STORAGES) {
+		Serial.println("Too many write-behind rolling code storages");
+		return;
+	}
+
+	storages[index] = storage;
+	storageCount = index + 1;
+
+	request();
+}
+
+void RollingCodeFlusher::request() {
+	if (taskHandle) {
+		xTaskNotifyGive(taskHandle);
+	}
+}
+
+void RollingCodeFlusher::task() {
+	while (true) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		// Wait for the burst of commands to end.
+		while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(idleMs))) {
+		}
+
+		const size_t count = storageCount;
+		for (size_t i = 0; i < count; i++) {
+			storages[i]->stage(batch);
+		}
+		const bool written = !batch || batch->commit();
+		for (size_t i = 0; i < count; i++) {
+			storages[i]->publish(written);
+		}
+	}
+}
+
+WriteBehindRollingCodeStorage::WriteBehindRollingCodeStorage(RollingCodeStorage *backing,
+															 RollingCodeFlusher *flusher, uint16_t reserveAhead)
+	: backing(backing), flusher(flusher), reserveAhead(reserveAhead > 0 ? reserveAhead : 1), staged(0),
+	  hasStaged(false) {
+	// Nothing is reserved yet; the flusher takes care of that before the first command, if it's quick enough.
+	uint16_t code;
+	if (!backing->peekCode(code)) {
+		// The backing store can't tell without reserving, so reserve just the one code.
+		code = backing->reserveCodes(1) + 1;
+	}
+	next = code;
+	reserved = code;
+	backingLock = xSemaphoreCreateMutex();
+
+	flusher->add(this);
+}
+
+uint16_t WriteBehindRollingCodeStorage::nextCode() { return reserveCodes(1); }
+
+bool WriteBehindRollingCodeStorage::peekCode(uint16_t &code) {
+	code = next;
+	return true;
+}
+
+uint16_t WriteBehindRollingCodeStorage::reserveCodes(uint16_t count) {
+	uint16_t first;
+	if (!tryReserveCodes(count, first)) {
+		// Any code returned now could be handed out again after a restart.
+		abort();
+	}
+	return first;
+}
+
+bool WriteBehindRollingCodeStorage::tryReserveCodes(uint16_t count, uint16_t &first) {
+	if (static_cast<uint16_t>(reserved - next) < count) {
+		Serial.println("Rolling code reservation exhausted, reserving synchronously");
+		if (!reserve(count)) {
+			return false;
+		}
+	}
+
+	first = next;
+	next = first + count;
+
+	// Top up once half of the reservation has been used.
+	if (static_cast<uint16_t>(reserved - next) < reserveAhead / 2 + 1) {
+		flusher->request();
+	}
+
+	return true;
+}
+
+bool WriteBehindRollingCodeStorage::reserve(uint16_t count) {
+	xSemaphoreTake(backingLock, portMAX_DELAY);
+
+	// Checked with the lock held, because the flusher may have topped up in the meantime.
+	const uint16_t available = reserved - next;
+	bool result = true;
+	if (available < count) {
+		// The backing storage continues where the previous reservation ended, or further on when codes staged in a
+		// batch weren't written. Storing the end of the new reservation covers those too.
+		const uint16_t missing = (count > reserveAhead ? count : reserveAhead) - available;
+		uint16_t first;
+		result = backing->tryReserveCodes(missing, first);
+		if (result) {
+			reserved = first + missing;
+		}
+	}
+
+	xSemaphoreGive(backingLock);
+
+	return result;
+}
+
+void WriteBehindRollingCodeStorage::stage(RollingCodeBatch *batch) {
+	// Held until publish, so running out of codes in between can't take codes from the batch before it's written.
+	xSemaphoreTake(backingLock, portMAX_DELAY);
+
+	hasStaged = false;
+	const uint16_t available = reserved - next;
+	if (available < reserveAhead) {
+		const uint16_t count = reserveAhead - available;
+		uint16_t first;
+		if (batch) {
+			hasStaged = backing->tryReserveCodesInBatch(count, first, *batch);
+		} else {
+			hasStaged = backing->tryReserveCodes(count, first);
+		}
+		if (hasStaged) {
+			staged = first + count;
+		}
+	}
+}
+
+void WriteBehindRollingCodeStorage::publish(bool written) {
+	if (hasStaged && written) {
+		reserved = staged;
+	}
+
+	xSemaphoreGive(backingLock);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef ESP32
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+
+#include "RollingCodeStorage.h"
+
+class WriteBehindRollingCodeStorage;
+
+/**
+ * Low priority task that keeps the reservations of write-behind storages topped up. Requests are coalesced until
+ * none have come in for the idle window, after which all storages are topped up in one pass, so the flash writes
+ * happen after a burst of commands instead of during it. When the backing storages share a store, the pass reserves
+ * the codes of all of them into its batch and writes the store once.
+ */
+class RollingCodeFlusher {
+public:
+	static constexpr size_t MAX_STORAGES = 64;
+
+private:
+	uint32_t idleMs;
+	RollingCodeBatch *batch;
+	TaskHandle_t taskHandle;
+	WriteBehindRollingCodeStorage *storages[MAX_STORAGES];
+	std::atomic<size_t> storageCount;
+
+	void task();
+
+public:
+	/**
+	 * @param idleMs how long requests have to stop coming in before the reservations are topped up
+	 * @param batch the store shared by the backing storages, or nullptr to have every storage write its own
+	 */
+	RollingCodeFlusher(uint32_t idleMs, RollingCodeBatch *batch = nullptr);
+	void begin(UBaseType_t priority);
+	void add(WriteBehindRollingCodeStorage *storage);
+	void request();
+};
+
+/**
+ * Hands out rolling codes from memory, so sending a command never waits for flash. The codes are reserved in the
+ * backing storage ahead of time by a RollingCodeFlusher. Because only reserved codes are handed out, a code is
+ * never reused after a reset; at most the unused part of the reservation is skipped. When the reservation runs out
+ * before the flusher got to it, nextCode reserves synchronously. The backing storage must not be used by anything
+ * else.
+ */
+class WriteBehindRollingCodeStorage : public RollingCodeStorage {
+private:
+	RollingCodeStorage *backing;
+	RollingCodeFlusher *flusher;
+	uint16_t reserveAhead;
+	// Next is only changed by the task taking codes; reserved only with the backing lock held.
+	std::atomic<uint16_t> next;
+	std::atomic<uint16_t> reserved;
+	SemaphoreHandle_t backingLock;
+	// The end of the codes reserved into the flusher's batch, which become available once it's committed.
+	uint16_t staged;
+	bool hasStaged;
+
+	bool reserve(uint16_t count);
+
+public:
+	/**
+	 * @param backing the storage the codes are reserved in
+	 * @param flusher the task that tops up the reservation
+	 * @param reserveAhead the number of codes to keep reserved
+	 */
+	WriteBehindRollingCodeStorage(RollingCodeStorage *backing, RollingCodeFlusher *flusher, uint16_t reserveAhead);
+	uint16_t nextCode() override;
+	bool peekCode(uint16_t &code) override;
+	uint16_t reserveCodes(uint16_t count) override;
+	bool tryReserveCodes(uint16_t count, uint16_t &first) override;
+	/**
+	 * Reserve the codes that top up the reservation into a batch, or right away without one. Called from the
+	 * flusher task, which must call publish next. Until then, running out of codes waits for the flusher.
+	 */
+	void stage(RollingCodeBatch *batch);
+	/**
+	 * Make the staged codes available when they were written.
+	 *
+	 * @param written whether the batch the codes were staged in was committed
+	 */
+	void publish(bool written);
+};
+
+#endif
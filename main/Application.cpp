@@ -7,7 +7,8 @@
 
 LOG_TAG(Application);
 
-Application::Application() : _network_connection(&_queue), _mqtt_connection(&_queue), _device(_mqtt_connection) {}
+Application::Application()
+    : _network_connection(&_queue), _mqtt_connection(&_queue), _device(_mqtt_connection, &_queue) {}
 
 void Application::begin(bool silent) {
     ESP_LOGI(TAG, "Setting up the log manager");
@@ -6,7 +6,7 @@
 
 LOG_TAG(Device);
 
-Device::Device(MQTTConnection& mqtt_connection) : _mqtt_connection(mqtt_connection) {}
+Device::Device(MQTTConnection& mqtt_connection, Queue* queue) : _mqtt_connection(mqtt_connection), _queue(queue) {}
 
 void Device::begin() {
     load_state();
@@ -21,11 +21,49 @@ void Device::begin() {
         }
     });
 
-    _mqtt_connection.on_remote_command_requested(
-        [this](auto command) { _devices.queue_command(command.device_id, command.command_id, command.long_press); });
+    _mqtt_connection.on_remote_command_requested([this](auto command) {
+        _devices.queue_command(command.device_id, command.command_id, command.long_press, command.received_ms,
+                               command.deadline_ms);
+    });
+
+    _mqtt_connection.on_remote_hold_requested([this](auto hold) {
+        _devices.queue_hold(hold.device_id, hold.command_id, hold.duration_ms, hold.received_ms);
+    });
+
+    _mqtt_connection.on_remote_hold_stop_requested([this](auto device_id) { _devices.stop_hold(device_id); });
+
+    _mqtt_connection.on_remote_cancel_requested([this](auto device_id) { _devices.cancel(device_id); });
+
+    _devices.on_transmit_timing_changed([this](const auto& statistics) {
+        // Reported from the transmit task.
+        _queue->enqueue([this, statistics]() {
+            _state.transmit_timing = statistics;
+
+            state_changed();
+        });
+    });
+
+    _devices.on_queue_statistics_changed([this](const auto& statistics) {
+        _queue->enqueue([this, statistics]() {
+            _state.command_queue = statistics;
+
+            state_changed();
+        });
+    });
+
+    _devices.on_command_received([this](auto command) {
+        // Reported from the receive task.
+        _queue->enqueue([this, command]() {
+            if (_mqtt_connection.is_connected()) {
+                _mqtt_connection.send_received_command(command);
+            }
+        });
+    });
 }
 
-void Device::set_configuration(DeviceConfiguration* configuration) { _devices.set_configuration(configuration); }
+void Device::set_configuration(DeviceConfiguration* configuration) {
+    _devices.set_devices(configuration->get_devices());
+}
 
 void Device::state_changed() {
     if (_mqtt_connection.is_connected()) {
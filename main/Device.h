@@ -2,15 +2,17 @@
 
 #include "DeviceState.h"
 #include "MQTTConnection.h"
+#include "Queue.h"
 #include "RemoteDeviceManager.h"
 
 class Device {
     MQTTConnection& _mqtt_connection;
+    Queue* _queue;
     DeviceState _state;
     RemoteDeviceManager _devices;
 
 public:
-    Device(MQTTConnection& mqtt_connection);
+    Device(MQTTConnection& mqtt_connection, Queue* queue);
 
     void begin();
     void set_configuration(DeviceConfiguration* configuration);
@@ -30,11 +30,14 @@ esp_err_t DeviceConfiguration::load() {
         return err;
     }
 
+    return parse(json);
+}
+
+esp_err_t DeviceConfiguration::parse(const string& json) {
     cJSON_Data data = {cJSON_Parse(json.c_str())};
     if (!*data) {
         ESP_LOGE(TAG, "Failed to parse JSON");
-        err = ESP_ERR_INVALID_ARG;
-        return err;
+        return ESP_ERR_INVALID_ARG;
     }
 
     auto device_name_item = cJSON_GetObjectItemCaseSensitive(*data, "deviceName");
@@ -142,8 +145,19 @@ esp_err_t DeviceConfiguration::load() {
             return ESP_ERR_INVALID_ARG;
         }
 
-        _devices.push_back(
-            RemoteDeviceConfiguration(device_id->valuestring, device_short_id->valuestring, device_name->valuestring));
+        auto radio = -1;
+        auto device_radio = cJSON_GetObjectItemCaseSensitive(device, "radio");
+        if (device_radio != nullptr) {
+            if (!cJSON_IsNumber(device_radio) || device_radio->valueint < 0) {
+                ESP_LOGE(TAG, "Device radio must be a non-negative number");
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            radio = device_radio->valueint;
+        }
+
+        _devices.push_back(RemoteDeviceConfiguration(device_id->valuestring, device_short_id->valuestring,
+                                                     device_name->valuestring, radio));
 
         ESP_LOGI(TAG, "Device ID %s, name %s", device_id->valuestring, device_name->valuestring);
     }
@@ -6,14 +6,17 @@ class RemoteDeviceConfiguration {
     string _id;
     string _short_id;
     string _name;
+    int _radio;
 
 public:
-    RemoteDeviceConfiguration(const string& id, const string& short_id, const string& name)
-        : _id(id), _short_id(short_id), _name(name) {}
+    RemoteDeviceConfiguration(const string& id, const string& short_id, const string& name, int radio)
+        : _id(id), _short_id(short_id), _name(name), _radio(radio) {}
 
     const string& get_id() const { return _id; }
     const string& get_short_id() const { return _short_id; }
     const string& get_name() const { return _name; }
+    // Index of the radio that sends the commands of the device, or -1 to pick one.
+    int get_radio() const { return _radio; }
 };
 
 class DeviceConfiguration {
@@ -36,6 +39,8 @@ public:
     DeviceConfiguration& operator=(DeviceConfiguration&&) = delete;
 
     esp_err_t load();
+    // Takes the configuration from a JSON document, as downloaded by load.
+    esp_err_t parse(const string& json);
 
     const string& get_endpoint() const { return _endpoint; }
     const string& get_device_name() const { return _device_name; }
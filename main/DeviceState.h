@@ -1,5 +1,54 @@
 #pragma once
 
+#include <optional>
 #include <vector>
 
-struct DeviceState {};
+struct TransmitTimingStatistics {
+    static constexpr int PULSE_KIND_COUNT = 5;
+
+    // Errors of the transmitted pulse durations in microseconds.
+    struct Pulse {
+        uint32_t p50_us;
+        uint32_t p99_us;
+        uint32_t max_us;
+    };
+
+    // Indexed by SomfyPulseKind.
+    Pulse pulses[PULSE_KIND_COUNT];
+};
+
+struct DeviceQueueStatistics {
+    // Commands sent to the device and the time they waited between being received and being sent.
+    uint32_t sent;
+    uint64_t wait_total_ms;
+    uint32_t wait_max_ms;
+
+    uint32_t get_average_wait_ms() const { return sent ? (uint32_t)(wait_total_ms / sent) : 0; }
+};
+
+struct CommandQueueStatistics {
+    // Short presses dropped because a different press for the same device was queued before they were sent.
+    uint32_t superseded;
+    // Short presses dropped because the same press for the device was still queued.
+    uint32_t duplicates;
+    // Estimated airtime of the dropped presses.
+    uint32_t airtime_saved_ms;
+    // Commands sent and dropped because they were past their deadline.
+    uint32_t sent;
+    uint32_t expired;
+    // Time between receiving a command and sending it.
+    uint64_t latency_total_ms;
+    uint32_t latency_max_ms;
+    // Most commands that were waiting at the same time, and commands dropped because the queue was full.
+    uint32_t high_water_mark;
+    uint32_t overflows;
+    // Indexed by device ID.
+    vector<DeviceQueueStatistics> devices;
+
+    uint32_t get_average_latency_ms() const { return sent ? (uint32_t)(latency_total_ms / sent) : 0; }
+};
+
+struct DeviceState {
+    optional<TransmitTimingStatistics> transmit_timing;
+    CommandQueueStatistics command_queue{};
+};
@@ -23,6 +23,15 @@ LOG_TAG(MQTTConnection);
 
 #define MAXIMUM_PACKET_SIZE 4096
 
+// Indexed by SomfyPulseKind.
+static const char* TRANSMIT_PULSE_KINDS[][2] = {
+    {"symbol", "Symbol"},
+    {"hardware_sync", "Hardware Sync"},
+    {"software_sync", "Software Sync"},
+    {"wake_up", "Wake-up"},
+    {"silence", "Silence"},
+};
+
 MQTTConnection::MQTTConnection(Queue* queue) : _queue(queue), _device_id(get_device_id()) {}
 
 void MQTTConnection::begin() {
@@ -179,69 +188,100 @@ void MQTTConnection::handle_data(esp_mqtt_event_handle_t event) {
         return;
     }
 
-    auto topic = string(event->topic, event->topic_len);
+    // The topic and data point into the MQTT client's buffer and aren't null terminated. Routing is done on views
+    // of the buffer, so the topic and the names in it aren't copied.
+    auto topic = string_view(event->topic, event->topic_len);
 
     if (!topic.starts_with(_topic_prefix)) {
-        ESP_LOGE(TAG, "Unexpected topic %s topic len %d data len %d", topic.c_str(), event->topic_len, event->data_len);
+        ESP_LOGE(TAG, "Unexpected topic %.*s topic len %d data len %d", event->topic_len, event->topic,
+                 event->topic_len, event->data_len);
         return;
     }
 
-    auto sub_topic = topic.c_str() + _topic_prefix.length();
-    auto data = string(event->data, event->data_len);
+    auto sub_topic = topic.substr(_topic_prefix.length());
 
-    if (strncmp(sub_topic, "set/", 4) != 0) {
-        ESP_LOGE(TAG, "Unknown topic %s", topic.c_str());
+    if (!sub_topic.starts_with("set/")) {
+        ESP_LOGE(TAG, "Unknown topic %.*s", event->topic_len, event->topic);
         return;
     }
 
-    auto set_topic = sub_topic + 4;
+    auto set_topic = sub_topic.substr(4);
 
     int remote_id = -1;
 
-    auto offset = strchr(set_topic, '/');
-    if (offset) {
-        auto remote_name = string(set_topic, offset - set_topic);
+    auto offset = set_topic.find('/');
+    if (offset != string_view::npos) {
+        auto remote_name = set_topic.substr(0, offset);
         remote_id = find_remote_id(remote_name);
         if (remote_id == -1) {
-            ESP_LOGE(TAG, "Unknown remote ID %s", remote_name.c_str());
+            ESP_LOGE(TAG, "Unknown remote ID %.*s", (int)remote_name.size(), remote_name.data());
             return;
         }
 
-        set_topic = offset + 1;
+        set_topic = set_topic.substr(offset + 1);
     }
 
     if (remote_id == -1) {
-        if (strcmp(set_topic, "identify") == 0) {
+        if (set_topic == "identify") {
             ESP_LOGI(TAG, "Requested identification");
 
             _identify_requested.queue(_queue);
-        } else if (strcmp(set_topic, "restart") == 0) {
+        } else if (set_topic == "restart") {
             ESP_LOGI(TAG, "Requested restart");
 
             _restart_requested.queue(_queue);
         } else {
-            ESP_LOGE(TAG, "Unknown topic %s", topic.c_str());
+            ESP_LOGE(TAG, "Unknown topic %.*s", event->topic_len, event->topic);
         }
+    } else if (set_topic == "hold_stop") {
+        ESP_LOGI(TAG, "Requested stop of hold %.*s", (int)sub_topic.size(), sub_topic.data());
+
+        _remote_hold_stop_requested.queue(_queue, remote_id);
+    } else if (set_topic == "cancel") {
+        ESP_LOGI(TAG, "Requested cancel %.*s", (int)sub_topic.size(), sub_topic.data());
+
+        _remote_cancel_requested.queue(_queue, remote_id);
     } else {
-        auto len = strlen(set_topic);
+        auto match = set_topic;
         bool long_press = false;
+        bool hold = false;
 
-        if (len > 5 && strcmp(set_topic + len - 5, "_long") == 0) {
-            len -= 5;
+        if (match.ends_with("_long")) {
+            match.remove_suffix(5);
             long_press = true;
+        } else if (match.ends_with("_hold_start")) {
+            match.remove_suffix(11);
+            hold = true;
         }
 
-        const auto match = string(set_topic, len);
-
-        auto command_id = command_id_from_name(match.c_str());
+        auto command_id = command_id_from_name(match);
         if (!command_id.has_value()) {
-            ESP_LOGE(TAG, "Unknown command ID %s", set_topic);
+            ESP_LOGE(TAG, "Unknown command ID %.*s", (int)set_topic.size(), set_topic.data());
             return;
         }
 
-        ESP_LOGI(TAG, "Requested remote command %s", sub_topic);
+        if (hold) {
+            // The payload optionally is the duration of the hold in milliseconds. Anything else, e.g. the payload
+            // of a button, holds until stopped.
+            uint32_t duration_ms = 0;
+            from_chars(event->data, event->data + event->data_len, duration_ms);
+
+            ESP_LOGI(TAG, "Requested remote hold %.*s duration %" PRIu32, (int)sub_topic.size(), sub_topic.data(),
+                     duration_ms);
+
+            _remote_hold_requested.queue(_queue, {remote_id, command_id.value(), duration_ms, esp_get_millis()});
+            return;
+        }
 
-        _remote_command_requested.queue(_queue, {remote_id, command_id.value(), long_press});
+        // The payload optionally is the number of milliseconds after which the command is stale and must not be
+        // sent anymore.
+        uint32_t deadline_ms = 0;
+        from_chars(event->data, event->data + event->data_len, deadline_ms);
+
+        ESP_LOGI(TAG, "Requested remote command %.*s", (int)sub_topic.size(), sub_topic.data());
+
+        _remote_command_requested.queue(_queue,
+                                        {remote_id, command_id.value(), long_press, esp_get_millis(), deadline_ms});
     }
 }
 
@@ -304,7 +344,89 @@ void MQTTConnection::publish_discovery() {
         REGISTER_DEVICE_BUTTON(device, "Prog (long)", "prog_long", "mdi:cog");
         REGISTER_DEVICE_BUTTON(device, "Sun Flag", "sun_flag", "mdi:weather-sunny");
         REGISTER_DEVICE_BUTTON(device, "Flag", "flag", "mdi:weather-sunny-off");
+
+        publish_device_queue_sensor_discovery(device, "sent", "Sent Commands", nullptr, nullptr, "total_increasing");
+        publish_device_queue_sensor_discovery(device, "wait_avg", "Command Wait Average", "ms", "duration",
+                                              "measurement");
+        publish_device_queue_sensor_discovery(device, "wait_max", "Command Wait Max", "ms", "duration",
+                                              "measurement");
     }
+
+    publish_queue_sensor_discovery("superseded", "Superseded Commands", nullptr, nullptr);
+    publish_queue_sensor_discovery("duplicates", "Duplicate Commands", nullptr, nullptr);
+    publish_queue_sensor_discovery("airtime_saved", "Airtime Saved", "ms", "duration");
+    publish_queue_sensor_discovery("sent", "Sent Commands", nullptr, nullptr);
+    publish_queue_sensor_discovery("expired", "Expired Commands", nullptr, nullptr);
+    publish_queue_sensor_discovery("latency_avg", "Command Latency Average", "ms", "duration", "measurement");
+    publish_queue_sensor_discovery("latency_max", "Command Latency Max", "ms", "duration", "measurement");
+    publish_queue_sensor_discovery("high_water_mark", "Command Queue High Water Mark", nullptr, nullptr, "measurement");
+    publish_queue_sensor_discovery("overflows", "Command Queue Overflows", nullptr, nullptr);
+
+#ifdef CONFIG_DEVICE_TIMING_STATS
+    for (const auto& kind : TRANSMIT_PULSE_KINDS) {
+        publish_timing_sensor_discovery(kind[0], kind[1], "p50", "P50");
+        publish_timing_sensor_discovery(kind[0], kind[1], "p99", "P99");
+        publish_timing_sensor_discovery(kind[0], kind[1], "max", "Max");
+    }
+#endif
+}
+
+void MQTTConnection::publish_timing_sensor_discovery(const char* kind, const char* kind_name, const char* metric,
+                                                     const char* metric_name) {
+    const auto object_id = strformat("transmit_timing_%s_%s", kind, metric);
+
+    auto root = create_discovery("sensor", strformat("%s Timing Error %s", kind_name, metric_name).c_str(),
+                                 object_id.c_str(), nullptr, nullptr, "mdi:timer-alert-outline", "diagnostic",
+                                 "duration", true);
+
+    cJSON_AddStringToObject(*root, "state_topic", (_topic_prefix + "state").c_str());
+    cJSON_AddStringToObject(*root, "value_template",
+                            strformat("{{ value_json.transmit_timing.%s.%s }}", kind, metric).c_str());
+    cJSON_AddStringToObject(*root, "unit_of_measurement", "µs");
+    cJSON_AddStringToObject(*root, "state_class", "measurement");
+
+    publish_json(*root, strformat("homeassistant/sensor/%s/%s/config", _device_id.c_str(), object_id.c_str()), true);
+}
+
+void MQTTConnection::publish_queue_sensor_discovery(const char* metric, const char* name, const char* unit,
+                                                    const char* device_class, const char* state_class) {
+    const auto object_id = strformat("command_queue_%s", metric);
+
+    auto root = create_discovery("sensor", name, object_id.c_str(), nullptr, nullptr, "mdi:playlist-remove",
+                                 "diagnostic", device_class, true);
+
+    cJSON_AddStringToObject(*root, "state_topic", (_topic_prefix + "state").c_str());
+    cJSON_AddStringToObject(*root, "value_template", strformat("{{ value_json.command_queue.%s }}", metric).c_str());
+    if (unit) {
+        cJSON_AddStringToObject(*root, "unit_of_measurement", unit);
+    }
+    cJSON_AddStringToObject(*root, "state_class", state_class);
+
+    publish_json(*root, strformat("homeassistant/sensor/%s/%s/config", _device_id.c_str(), object_id.c_str()), true);
+}
+
+void MQTTConnection::publish_device_queue_sensor_discovery(const RemoteDeviceConfiguration& device, const char* metric,
+                                                           const char* name, const char* unit,
+                                                           const char* device_class, const char* state_class) {
+    const auto object_id = strformat("command_queue_%s", metric);
+
+    auto root = create_discovery("sensor", name, strformat("%s_%s", device.get_id().c_str(), object_id.c_str()).c_str(),
+                                 device.get_name().c_str(), device.get_id().c_str(), "mdi:timer-sand", "diagnostic",
+                                 device_class, true);
+
+    cJSON_AddStringToObject(*root, "state_topic", (_topic_prefix + "state").c_str());
+    cJSON_AddStringToObject(
+        *root, "value_template",
+        strformat("{{ value_json.command_queue.devices['%s'].%s }}", device.get_id().c_str(), metric).c_str());
+    if (unit) {
+        cJSON_AddStringToObject(*root, "unit_of_measurement", unit);
+    }
+    cJSON_AddStringToObject(*root, "state_class", state_class);
+
+    publish_json(*root,
+                 strformat("homeassistant/sensor/%s_%s/%s/config", _device_id.c_str(), device.get_id().c_str(),
+                           object_id.c_str()),
+                 true);
 }
 
 void MQTTConnection::publish_button_discovery(const char* name, const char* command_topic, const char* icon,
@@ -417,6 +539,43 @@ void MQTTConnection::send_state(DeviceState& state) {
 
     cJSON_AddBoolToObject(*root, "online", true);
 
+    if (state.transmit_timing.has_value()) {
+        const auto transmit_timing = cJSON_AddObjectToObject(*root, "transmit_timing");
+
+        for (int i = 0; i < TransmitTimingStatistics::PULSE_KIND_COUNT; i++) {
+            const auto& pulse = state.transmit_timing->pulses[i];
+            const auto item = cJSON_AddObjectToObject(transmit_timing, TRANSMIT_PULSE_KINDS[i][0]);
+
+            cJSON_AddNumberToObject(item, "p50", pulse.p50_us);
+            cJSON_AddNumberToObject(item, "p99", pulse.p99_us);
+            cJSON_AddNumberToObject(item, "max", pulse.max_us);
+        }
+    }
+
+    const auto command_queue = cJSON_AddObjectToObject(*root, "command_queue");
+    cJSON_AddNumberToObject(command_queue, "superseded", state.command_queue.superseded);
+    cJSON_AddNumberToObject(command_queue, "duplicates", state.command_queue.duplicates);
+    cJSON_AddNumberToObject(command_queue, "airtime_saved", state.command_queue.airtime_saved_ms);
+    cJSON_AddNumberToObject(command_queue, "sent", state.command_queue.sent);
+    cJSON_AddNumberToObject(command_queue, "expired", state.command_queue.expired);
+    cJSON_AddNumberToObject(command_queue, "latency_avg", state.command_queue.get_average_latency_ms());
+    cJSON_AddNumberToObject(command_queue, "latency_max", state.command_queue.latency_max_ms);
+    cJSON_AddNumberToObject(command_queue, "high_water_mark", state.command_queue.high_water_mark);
+    cJSON_AddNumberToObject(command_queue, "overflows", state.command_queue.overflows);
+
+    // Per device wait times, keyed by the ID of the device.
+    const auto devices = cJSON_AddObjectToObject(command_queue, "devices");
+    const auto& configured_devices = _configuration->get_devices();
+
+    for (size_t i = 0; i < state.command_queue.devices.size() && i < configured_devices.size(); i++) {
+        const auto& statistics = state.command_queue.devices[i];
+        const auto item = cJSON_AddObjectToObject(devices, configured_devices[i].get_id().c_str());
+
+        cJSON_AddNumberToObject(item, "sent", statistics.sent);
+        cJSON_AddNumberToObject(item, "wait_avg", statistics.get_average_wait_ms());
+        cJSON_AddNumberToObject(item, "wait_max", statistics.wait_max_ms);
+    }
+
     auto json = cJSON_PrintUnformatted(*root);
 
     auto topic = _topic_prefix + "state";
@@ -428,38 +587,83 @@ void MQTTConnection::send_state(DeviceState& state) {
     cJSON_free(json);
 }
 
-optional<RemoteCommandId> MQTTConnection::command_id_from_name(const char* name) {
-    if (strcmp(name, "my") == 0) {
+void MQTTConnection::send_received_command(const ReceivedRemoteCommand& command) {
+    ESP_ERROR_ASSERT(_client);
+
+    cJSON_Data root = {cJSON_CreateObject()};
+
+    cJSON_AddStringToObject(*root, "remote_id", strformat("%06" PRIX32, command.remote_id).c_str());
+    cJSON_AddStringToObject(*root, "command", command_name_from_id(command.command_id));
+    cJSON_AddNumberToObject(*root, "rolling_code", command.rolling_code);
+
+    auto json = cJSON_PrintUnformatted(*root);
+
+    auto topic = _topic_prefix + "received";
+    auto result = esp_mqtt_client_publish(_client, topic.c_str(), json, 0, QOS_MIN_ONE, false);
+    if (result < 0) {
+        ESP_LOGE(TAG, "Sending received command message failed with error %d", result);
+    }
+
+    cJSON_free(json);
+}
+
+optional<RemoteCommandId> MQTTConnection::command_id_from_name(string_view name) {
+    if (name == "my") {
         return RemoteCommandId::My;
     }
-    if (strcmp(name, "up") == 0) {
+    if (name == "up") {
         return RemoteCommandId::Up;
     }
-    if (strcmp(name, "my_up") == 0) {
+    if (name == "my_up") {
         return RemoteCommandId::MyUp;
     }
-    if (strcmp(name, "down") == 0) {
+    if (name == "down") {
         return RemoteCommandId::Down;
     }
-    if (strcmp(name, "my_down") == 0) {
+    if (name == "my_down") {
         return RemoteCommandId::MyDown;
     }
-    if (strcmp(name, "up_down") == 0) {
+    if (name == "up_down") {
         return RemoteCommandId::UpDown;
     }
-    if (strcmp(name, "prog") == 0) {
+    if (name == "prog") {
         return RemoteCommandId::Prog;
     }
-    if (strcmp(name, "sun_flag") == 0) {
+    if (name == "sun_flag") {
         return RemoteCommandId::SunFlag;
     }
-    if (strcmp(name, "flag") == 0) {
+    if (name == "flag") {
         return RemoteCommandId::Flag;
     }
     return {};
 }
 
-int MQTTConnection::find_remote_id(const string& remote_name) {
+const char* MQTTConnection::command_name_from_id(RemoteCommandId command_id) {
+    switch (command_id) {
+        case RemoteCommandId::My:
+            return "my";
+        case RemoteCommandId::Up:
+            return "up";
+        case RemoteCommandId::MyUp:
+            return "my_up";
+        case RemoteCommandId::Down:
+            return "down";
+        case RemoteCommandId::MyDown:
+            return "my_down";
+        case RemoteCommandId::UpDown:
+            return "up_down";
+        case RemoteCommandId::Prog:
+            return "prog";
+        case RemoteCommandId::SunFlag:
+            return "sun_flag";
+        case RemoteCommandId::Flag:
+            return "flag";
+        default:
+            return "unknown";
+    }
+}
+
+int MQTTConnection::find_remote_id(string_view remote_name) {
     int index = 0;
 
     for (const auto& device : _configuration->get_devices()) {
@@ -2,6 +2,7 @@
 
 #include <optional>
 #include <set>
+#include <string_view>
 
 #include "Callback.h"
 #include "DeviceConfiguration.h"
@@ -19,6 +20,16 @@ struct MQTTRemoteCommand {
     int device_id;
     RemoteCommandId command_id;
     bool long_press;
+    uint32_t received_ms;
+    // Zero for the default deadline of the command.
+    uint32_t deadline_ms;
+};
+
+struct MQTTRemoteHold {
+    int device_id;
+    RemoteCommandId command_id;
+    uint32_t duration_ms;
+    uint32_t received_ms;
 };
 
 class MQTTConnection {
@@ -35,6 +46,9 @@ class MQTTConnection {
     Callback<void> _identify_requested;
     Callback<void> _restart_requested;
     Callback<MQTTRemoteCommand> _remote_command_requested;
+    Callback<MQTTRemoteHold> _remote_hold_requested;
+    Callback<int> _remote_hold_stop_requested;
+    Callback<int> _remote_cancel_requested;
 
 public:
     MQTTConnection(Queue* queue);
@@ -43,10 +57,14 @@ public:
     void begin();
     bool is_connected() { return !!_client; }
     void send_state(DeviceState& state);
+    void send_received_command(const ReceivedRemoteCommand& command);
     void on_connected_changed(function<void(MQTTConnectionState)> func) { _connected_changed.add(func); }
     void on_identify_requested(function<void()> func) { _identify_requested.add(func); }
     void on_restart_requested(function<void()> func) { _restart_requested.add(func); }
     void on_remote_command_requested(function<void(MQTTRemoteCommand)> func) { _remote_command_requested.add(func); }
+    void on_remote_hold_requested(function<void(MQTTRemoteHold)> func) { _remote_hold_requested.add(func); }
+    void on_remote_hold_stop_requested(function<void(int)> func) { _remote_hold_stop_requested.add(func); }
+    void on_remote_cancel_requested(function<void(int)> func) { _remote_cancel_requested.add(func); }
 
 private:
     void event_handler(esp_event_base_t eventBase, int32_t eventId, void* eventData);
@@ -62,10 +80,18 @@ private:
     void publish_subdevice_button_discovery(const char* name, const char* command_topic, const char* subdevice_name,
                                             const char* subdevice_id, const char* icon, const char* entity_category,
                                             const char* device_class);
+    void publish_timing_sensor_discovery(const char* kind, const char* kind_name, const char* metric,
+                                         const char* metric_name);
+    void publish_queue_sensor_discovery(const char* metric, const char* name, const char* unit,
+                                        const char* device_class, const char* state_class = "total_increasing");
+    void publish_device_queue_sensor_discovery(const RemoteDeviceConfiguration& device, const char* metric,
+                                               const char* name, const char* unit, const char* device_class,
+                                               const char* state_class);
     cJSON_Data create_discovery(const char* component, const char* name, const char* object_id,
                                 const char* subdevice_name, const char* subdevice_id, const char* icon,
                                 const char* entity_category, const char* device_class, bool enabled_by_default);
     string get_firmware_version();
-    optional<RemoteCommandId> command_id_from_name(const char* name);
-    int find_remote_id(const string& remote_name);
+    optional<RemoteCommandId> command_id_from_name(string_view name);
+    const char* command_name_from_id(RemoteCommandId command_id);
+    int find_remote_id(string_view remote_name);
 };
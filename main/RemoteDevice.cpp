@@ -1,5 +1,8 @@
 #include "NVSRollingCodeStorage.h"
+#include "PartitionRollingCodeStorage.h"
 #include "SomfyRemote.h"
+#include "SomfySession.h"
+#include "WriteBehindRollingCodeStorage.h"
 
 // Comment to ensure the SomfyRemote.h header stays at the top.
 
@@ -7,59 +10,330 @@
 
 #include "RemoteDevice.h"
 
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+#include "RemoteTable.h"
+
 #define NVS_STORAGE "somfy_remotes"
+#define REMOTE_TABLE_KEY "remotes"
+#define CODE_LOG_PARTITION "codes"
+// Codes kept reserved per remote by the write-behind cache. A restart skips at most this many codes.
+#define ROLLING_CODE_RESERVE_AHEAD 8
+// The flusher waits for commands to stop coming in for this long before it writes to flash.
+#define ROLLING_CODE_FLUSH_IDLE_MS 1000
+#define ROLLING_CODE_FLUSH_PRIORITY 1
 
 LOG_TAG(RemoteDevice);
 
+// All remotes share one handle to the storage namespace. It's opened on first use, after flash has been set up, and
+// stays open for the lifetime of the application.
+static nvs_handle_t get_storage_handle() {
+    static nvs_handle_t handle = [] {
+        nvs_handle_t result;
+        ESP_ERROR_CHECK(nvs_open(NVS_STORAGE, NVS_READWRITE, &result));
+        return result;
+    }();
+
+    return handle;
+}
+
+// Loaded in a single read when the first remote is created. When that fails, no device gets a remote.
+static RemoteTable* get_remote_table() {
+    static RemoteTable* table = [] {
+        auto result = new RemoteTable(get_storage_handle(), REMOTE_TABLE_KEY);
+        if (result->load() != ESP_OK) {
+            ESP_LOGE(TAG, "Remote table can't be loaded, not transmitting for any device");
+        }
+        return result;
+    }();
+
+    return table;
+}
+
+// Stores the rolling code in the remote table. Like NVSRollingCodeStorage, it reserves blocks of codes by storing
+// the end of the block, so only one in block size codes writes the table. The radio task and the flusher of the
+// write-behind cache both reserve codes, so the codes and the write of the table are guarded by a mutex.
+class TableRollingCodeStorage : public RollingCodeStorage {
+    RemoteTable* _table;
+    RemoteTableEntry _entry;
+    uint16_t _block_size;
+    uint16_t _next;
+    mutex _lock;
+
+    bool reserve(uint16_t count, uint16_t& first, bool staged) {
+        lock_guard<mutex> lock(_lock);
+
+        // Codes are only handed out from a block whose end is stored. A table that wasn't saved may not hold it.
+        if (count > (uint16_t)(_entry.rolling_code - _next) || !_table->is_saved()) {
+            _entry.rolling_code = _next + count + _block_size - 1;
+            if (staged ? !_table->stage(_entry) : !_table->put(_entry)) {
+                return false;
+            }
+        }
+
+        first = _next;
+        _next += count;
+        return true;
+    }
+
+public:
+    TableRollingCodeStorage(RemoteTable* table, const RemoteTableEntry& entry, uint16_t block_size)
+        : _table(table), _entry(entry), _block_size(block_size > 0 ? block_size : 1), _next(entry.rolling_code) {}
+
+    uint16_t nextCode() override { return reserveCodes(1); }
+    bool peekCode(uint16_t& code) override {
+        lock_guard<mutex> lock(_lock);
+
+        code = _next;
+        return true;
+    }
+
+    uint16_t reserveCodes(uint16_t count) override {
+        uint16_t first;
+        if (!tryReserveCodes(count, first)) {
+            // Any code returned now could be handed out again after a restart.
+            abort();
+        }
+        return first;
+    }
+
+    bool tryReserveCodes(uint16_t count, uint16_t& first) override { return reserve(count, first, false); }
+
+    bool tryReserveCodesInBatch(uint16_t count, uint16_t& first, RollingCodeBatch& batch) override {
+        return reserve(count, first, &batch == _table);
+    }
+};
+
+#ifdef CONFIG_DEVICE_ROLLING_CODE_LOG
+
+// The log is shared by all remotes and scanned when the first remote is created. It's missing when the device was
+// updated over the air from a firmware with the old partition table, in which case the remotes stay on NVS.
+//
+// The table never gives up a remote, so a remote missing from it is one of a table that was lost, which is never
+// used again. The log drops those to make room for new remotes.
+static PartitionRollingCodeLog* get_code_log() {
+    static PartitionRollingCodeLog* log = [] {
+        auto result = new PartitionRollingCodeLog(CODE_LOG_PARTITION);
+        if (!result->begin()) {
+            ESP_LOGW(TAG, "Rolling code log unavailable, storing rolling codes in NVS");
+            delete result;
+            return (PartitionRollingCodeLog*)nullptr;
+        }
+
+        const auto table = get_remote_table();
+        if (table->is_loaded()) {
+            const auto remote_ids = table->get_remote_ids();
+            result->retain(remote_ids.data(), remote_ids.size());
+        }
+        return result;
+    }();
+
+    return log;
+}
+
+#endif
+
+#ifdef CONFIG_DEVICE_ROLLING_CODE_WRITE_BEHIND
+
+// The flusher tops up all remotes in one pass, which writes the store they share once: the log when it's used, the
+// table otherwise.
+static RollingCodeFlusher* get_code_flusher() {
+    static RollingCodeFlusher* flusher = [] {
+        RollingCodeBatch* batch = get_remote_table();
+#ifdef CONFIG_DEVICE_ROLLING_CODE_LOG
+        if (const auto log = get_code_log()) {
+            batch = log;
+        }
+#endif
+
+        auto result = new RollingCodeFlusher(ROLLING_CODE_FLUSH_IDLE_MS, batch);
+        result->begin(ROLLING_CODE_FLUSH_PRIORITY);
+        return result;
+    }();
+
+    return flusher;
+}
+
+#endif
+
 struct SomfyRemoteWrapper {
-    NVSRollingCodeStorage code_storage;
+    TableRollingCodeStorage code_storage;
+    optional<PartitionRollingCodeStorage> log_code_storage;
+    optional<WriteBehindRollingCodeStorage> cached_code_storage;
     SomfyRemote remote;
+    // Commands are numbered as they're requested. A stop releases all holds requested up to then and a cancel
+    // drops all commands requested up to then, including the ones that are still queued.
+    atomic<uint32_t> requested{};
+    atomic<uint32_t> hold_stopped{};
+    atomic<uint32_t> cancelled{};
+
+    SomfyRemoteWrapper(uint8_t emitter_pin, const RemoteTableEntry& entry)
+        : code_storage(get_remote_table(), entry, CONFIG_DEVICE_ROLLING_CODE_BLOCK),
+          remote(emitter_pin, entry.remote_id, select_code_storage(entry.remote_id)) {}
+
+    SomfyRemoteWrapper(SomfyTransmitter* transmitter, const RemoteTableEntry& entry)
+        : code_storage(get_remote_table(), entry, CONFIG_DEVICE_ROLLING_CODE_BLOCK),
+          remote(transmitter, entry.remote_id, select_code_storage(entry.remote_id)) {}
+
+    RollingCodeStorage* select_code_storage(uint32_t remote_id) {
+        const auto backing = select_backing_code_storage(remote_id);
+
+#ifdef CONFIG_DEVICE_ROLLING_CODE_WRITE_BEHIND
+        return &cached_code_storage.emplace(backing, get_code_flusher(), ROLLING_CODE_RESERVE_AHEAD);
+#else
+        return backing;
+#endif
+    }
+
+    RollingCodeStorage* select_backing_code_storage(uint32_t remote_id) {
+#ifdef CONFIG_DEVICE_ROLLING_CODE_LOG
+        const auto log = get_code_log();
+        if (log) {
+            if (!log->contains(remote_id)) {
+                // Continue where the table left off, so the motors never see a code twice.
+                uint16_t code;
+                code_storage.peekCode(code);
 
-    SomfyRemoteWrapper(uint8_t emitter_pin, uint32_t remote, const char* nvs_key)
-        : code_storage(NVS_STORAGE, nvs_key), remote(emitter_pin, remote, &code_storage) {}
+                ESP_LOGI(TAG, "Moving rolling code %" PRIu16 " of remote %06" PRIX32 " to the log", code, remote_id);
+
+                if (!log->put(remote_id, code)) {
+                    ESP_LOGE(TAG, "Rolling code of remote %06" PRIX32 " can't be moved to the log, keeping it in NVS", remote_id);
+                    return &code_storage;
+                }
+            }
+
+            return &log_code_storage.emplace(log, remote_id);
+        }
+#endif
+
+        return &code_storage;
+    }
 };
 
-RemoteDevice::RemoteDevice(const string& device_id) : _device_id(device_id) {
-    const auto remote_id = get_remote_id();
+RemoteDevice::RemoteDevice(const string& device_id, SomfyTransmitter* transmitter)
+    : _device_id(device_id), _somfy_remote(nullptr) {
+    const auto found = get_table_entry();
+    if (!found.has_value()) {
+        // Without a stored rolling code, the next one isn't known. Guessing could reuse codes the motor has seen.
+        ESP_LOGE(TAG, "No remote for device %s, commands for it won't be sent", _device_id.c_str());
+        return;
+    }
 
-    ESP_LOGI(TAG, "Assigned remote ID %06" PRIX32 " to device %s", remote_id, _device_id.c_str());
+    const auto& entry = found.value();
 
-    auto wrapper = new SomfyRemoteWrapper(CONFIG_DEVICE_GDO0_PIN, remote_id, _device_id.c_str());
+    ESP_LOGI(TAG, "Assigned remote ID %06" PRIX32 " to device %s", entry.remote_id, _device_id.c_str());
+
+    SomfyRemoteWrapper* wrapper;
+    if (transmitter) {
+        wrapper = new SomfyRemoteWrapper(transmitter, entry);
+    } else {
+        wrapper = new SomfyRemoteWrapper(CONFIG_DEVICE_GDO0_PIN, entry);
+    }
 
     wrapper->remote.setup();
 
+    if (transmitter) {
+        // Render the most used commands up front so the first press doesn't have to encode anything.
+        wrapper->remote.prepareCommand(Command::My);
+        wrapper->remote.prepareCommand(Command::Up);
+        wrapper->remote.prepareCommand(Command::Down);
+    }
+
     _somfy_remote = wrapper;
 }
 
-uint32_t RemoteDevice::get_remote_id() {
-    nvs_handle rcs_handle;
-    ESP_ERROR_CHECK(nvs_open(NVS_STORAGE, NVS_READWRITE, &rcs_handle));
+optional<RemoteTableEntry> RemoteDevice::get_table_entry() {
+    const auto table = get_remote_table();
+    if (!table->is_loaded()) {
+        return {};
+    }
 
+    const auto device_hash = RemoteTable::hash_device_id(_device_id);
+
+    const auto entry = table->find(device_hash);
+    if (entry.has_value()) {
+        return entry.value();
+    }
+
+    // Older firmware stored the remote ID and rolling code of every device under separate keys. They're taken over
+    // and left in place.
+    const auto rcs_handle = get_storage_handle();
     const auto key = strformat("%s_id", _device_id.c_str());
 
     uint32_t remote_id;
     auto err = nvs_get_u32(rcs_handle, key.c_str(), &remote_id);
     if (err == ESP_ERR_NVS_NOT_FOUND) {
         remote_id = esp_random() & 0xffffff;
-        ESP_ERROR_CHECK(nvs_set_u32(rcs_handle, key.c_str(), remote_id));
     } else {
         ESP_ERROR_CHECK(err);
     }
-    ESP_ERROR_CHECK(nvs_commit(rcs_handle));
 
-    return remote_id;
-}
+    uint16_t rolling_code;
+    if (!NVSRollingCodeStorage(rcs_handle, _device_id.c_str()).peekCode(rolling_code)) {
+        return {};
+    }
 
-void RemoteDevice::send_command(RemoteCommandId command_id, bool long_press) {
-    int repeat;
-    if (long_press) {
-        // I'm really not sure what "long" is. For the Up/Down command 2 seconds seems fine. But
-        // for the My command, to switch motor direction, 2 seconds is not enough. Queueing a
-        // second long press works sometimes, but not consistently.
-        repeat = command_id == RemoteCommandId::My ? SOMFY_MS_TO_ITERS(4000) : SOMFY_MS_TO_ITERS(2000);
-    } else {
-        repeat = 4;
+    ESP_LOGI(TAG, "Adding device %s to the remote table with rolling code %" PRIu16, _device_id.c_str(),
+             rolling_code);
+
+    const RemoteTableEntry result = {device_hash, remote_id, rolling_code};
+    if (!table->put(result)) {
+        return {};
     }
 
-    ((SomfyRemoteWrapper*)_somfy_remote)->remote.sendCommand(static_cast<Command>(command_id), repeat);
+    return result;
+}
+
+uint32_t RemoteDevice::get_long_press_ms(RemoteCommandId command_id) {
+    // I'm really not sure what "long" is. For the Up/Down command 2 seconds seems fine. But
+    // for the My command, to switch motor direction, 2 seconds is not enough. Queueing a
+    // second long press works sometimes, but not consistently.
+    return command_id == RemoteCommandId::My ? 4000 : 2000;
+}
+
+void RemoteDevice::send_command(RemoteCommandId command_id) {
+    ((SomfyRemoteWrapper*)_somfy_remote)->remote.sendCommand(static_cast<Command>(command_id));
+}
+
+bool RemoteDevice::add_to_session(SomfySession& session, RemoteCommandId command_id) {
+    return session.add(((SomfyRemoteWrapper*)_somfy_remote)->remote, static_cast<Command>(command_id));
+}
+
+void RemoteDevice::prepare_command(RemoteCommandId command_id) {
+    ((SomfyRemoteWrapper*)_somfy_remote)->remote.prepareCommand(static_cast<Command>(command_id));
+}
+
+uint32_t RemoteDevice::request_command() { return ++((SomfyRemoteWrapper*)_somfy_remote)->requested; }
+
+void RemoteDevice::stop_hold() {
+    const auto wrapper = (SomfyRemoteWrapper*)_somfy_remote;
+
+    wrapper->hold_stopped = wrapper->requested.load();
+}
+
+void RemoteDevice::cancel() {
+    const auto wrapper = (SomfyRemoteWrapper*)_somfy_remote;
+
+    wrapper->cancelled = wrapper->requested.load();
+}
+
+bool RemoteDevice::is_cancelled(uint32_t sequence) {
+    return sequence <= ((SomfyRemoteWrapper*)_somfy_remote)->cancelled;
+}
+
+void RemoteDevice::hold_command(RemoteCommandId command_id, uint32_t sequence, uint32_t max_duration_ms,
+                                const function<bool()>& preempted) {
+    const auto wrapper = (SomfyRemoteWrapper*)_somfy_remote;
+
+    wrapper->remote.holdCommand(static_cast<Command>(command_id), max_duration_ms, [&]() {
+        return wrapper->hold_stopped < sequence && wrapper->cancelled < sequence && !preempted();
+    });
+}
+
+void RemoteDevice::prepare() { ((SomfyRemoteWrapper*)_somfy_remote)->remote.prepare(); }
+
+void RemoteDevice::set_timing_stats(SomfyTimingStats* timing_stats) {
+    ((SomfyRemoteWrapper*)_somfy_remote)->remote.setTimingStats(timing_stats);
 }
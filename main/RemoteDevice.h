@@ -1,5 +1,13 @@
 #pragma once
 
+#include <functional>
+#include <optional>
+
+class SomfySession;
+class SomfyTimingStats;
+class SomfyTransmitter;
+struct RemoteTableEntry;
+
 enum class RemoteCommandId : int {
     My = 0x1,
     Up = 0x2,
@@ -13,15 +21,35 @@ enum class RemoteCommandId : int {
     Long = 0x80
 };
 
+struct ReceivedRemoteCommand {
+    uint32_t remote_id;
+    RemoteCommandId command_id;
+    uint16_t rolling_code;
+};
+
 class RemoteDevice {
     string _device_id;
     void* _somfy_remote;
 
 public:
-    RemoteDevice(const string& device_id);
+    RemoteDevice(const string& device_id, SomfyTransmitter* transmitter);
+
+    // False when the remote ID and rolling code of the device couldn't be loaded; nothing may be sent for it then.
+    bool is_available() const { return _somfy_remote != nullptr; }
+    static uint32_t get_long_press_ms(RemoteCommandId command_id);
 
-    void send_command(RemoteCommandId command_id, bool long_press);
+    void send_command(RemoteCommandId command_id);
+    bool add_to_session(SomfySession& session, RemoteCommandId command_id);
+    void prepare_command(RemoteCommandId command_id);
+    uint32_t request_command();
+    void stop_hold();
+    void cancel();
+    bool is_cancelled(uint32_t sequence);
+    void hold_command(RemoteCommandId command_id, uint32_t sequence, uint32_t max_duration_ms,
+                      const function<bool()>& preempted);
+    void prepare();
+    void set_timing_stats(SomfyTimingStats* timing_stats);
 
 private:
-    uint32_t get_remote_id();
+    optional<RemoteTableEntry> get_table_entry();
 };
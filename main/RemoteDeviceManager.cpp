@@ -1,4 +1,10 @@
 #include "ELECHOUSE_CC1101_SRC_DRV.h"
+#include "CC1101SomfyTransmitter.h"
+#include "GPIOSomfyReceiver.h"
+#include "RMTSomfyTransmitter.h"
+#include "SomfyRemote.h"
+#include "SomfySession.h"
+#include "SomfyTimingStats.h"
 
 // Comment to ensure that the ELECHOUSE_CC1101_SRC_DRV.h file stays at the top.
 
@@ -6,76 +12,832 @@
 
 #include "RemoteDeviceManager.h"
 
-struct RemoteCommand {
-    int device_id;
-    RemoteCommandId command_id;
-    bool long_press;
+// Remotes repeat a frame for as long as the button is held; these are reported once.
+#define RECEIVE_REPEAT_WINDOW_MS 1000
+#define RECEIVE_POLL_INTERVAL_MS 10
+
+// Silence between the frames of different remotes in a session. The frames of a single remote are still
+// separated by the regular inter-frame silence.
+#define SESSION_FRAME_GAP_US 5000
+
+// Upper limit for holding a button, used when a hold doesn't specify a duration or it's never stopped.
+#define MAX_HOLD_MS 10000
+
+#ifdef CONFIG_DEVICE_RADIO_COUNT
+#define RADIO_COUNT CONFIG_DEVICE_RADIO_COUNT
+#else
+#define RADIO_COUNT 1
+#endif
+
+// CC1101SomfyTransmitter accesses the module selected in the driver from its refill task, without the radio lock.
+#if defined(CONFIG_DEVICE_TX_BACKEND_CC1101_FIFO) && RADIO_COUNT > 1
+#error "The CC1101 TX FIFO backend only supports a single radio"
+#endif
+
+// The radios share SCK, MOSI and MISO. Only the first one receives, on GDO2.
+struct RadioPins {
+    int csn_pin;
+    int gdo0_pin;
+};
+
+static const RadioPins RADIO_PINS[RADIO_COUNT] = {
+    {CONFIG_DEVICE_CSN_PIN, CONFIG_DEVICE_GDO0_PIN},
+#if RADIO_COUNT > 1
+    {CONFIG_DEVICE_RADIO1_CSN_PIN, CONFIG_DEVICE_RADIO1_GDO0_PIN},
+#endif
+#if RADIO_COUNT > 2
+    {CONFIG_DEVICE_RADIO2_CSN_PIN, CONFIG_DEVICE_RADIO2_GDO0_PIN},
+#endif
+#if RADIO_COUNT > 3
+    {CONFIG_DEVICE_RADIO3_CSN_PIN, CONFIG_DEVICE_RADIO3_GDO0_PIN},
+#endif
 };
 
 LOG_TAG(RemoteDeviceManager);
 
-RemoteDeviceManager::RemoteDeviceManager() {
-    _queue = xQueueCreate(10, sizeof(RemoteCommand));
-    ESP_ERROR_ASSERT(_queue);
+static_assert(TransmitTimingStatistics::PULSE_KIND_COUNT == SomfyTimingStats::KIND_COUNT,
+              "Pulse kinds must match SomfyPulseKind");
 
-    xTaskCreate([](auto arg) { ((RemoteDeviceManager*)arg)->task(); }, "RemoteDeviceManager::task",
-                CONFIG_ESP_MAIN_TASK_STACK_SIZE, this, 5, nullptr);
+RemoteDeviceManager::RemoteDeviceManager() {
+    _commands = new RingBuffer<RemoteCommand>(CONFIG_DEVICE_COMMAND_QUEUE_DEPTH);
+    // Urgent commands are stops, of which at most one per device is queued; later ones are merged into it. The queue
+    // only overflows with more devices than it's deep, and then the overflow policy applies as for other commands.
+    _urgent_commands = new RingBuffer<RemoteCommand>(CONFIG_DEVICE_COMMAND_QUEUE_DEPTH);
 }
 
 esp_err_t RemoteDeviceManager::begin() {
-    ESP_LOGI(TAG, "Initializing the CC1101");
-
-    ELECHOUSE_cc1101.setSpiPin(CONFIG_DEVICE_SCK_PIN, CONFIG_DEVICE_GDO1_PIN, CONFIG_DEVICE_MOSI_PIN,
-                               CONFIG_DEVICE_CSN_PIN);
+    // The modules are registered with the driver up front and selected with setModul before every access.
     ELECHOUSE_cc1101.setGDO(CONFIG_DEVICE_GDO0_PIN, CONFIG_DEVICE_GDO2_PIN);
-    if (!ELECHOUSE_cc1101.Init()) {
-        ESP_LOGE(TAG, "Failed to initialize the CC1101");
+
+    for (int i = 0; i < RADIO_COUNT; i++) {
+        ELECHOUSE_cc1101.addSpiPin(CONFIG_DEVICE_SCK_PIN, CONFIG_DEVICE_GDO1_PIN, CONFIG_DEVICE_MOSI_PIN,
+                                   RADIO_PINS[i].csn_pin, i);
+        ELECHOUSE_cc1101.addGDO0(RADIO_PINS[i].gdo0_pin, i);
+    }
+
+    for (int i = 0; i < RADIO_COUNT; i++) {
+        ESP_LOGI(TAG, "Initializing CC1101 radio %d", i);
+
+        ELECHOUSE_cc1101.setModul(i);
+        if (!ELECHOUSE_cc1101.Init()) {
+            ESP_LOGE(TAG, "Failed to initialize CC1101 radio %d", i);
+        }
+        ELECHOUSE_cc1101.setMHZ(433.42);
+
+        ESP_LOGI(TAG, "Successfully initialized CC1101 radio %d", i);
+
+        const auto radio = new RemoteRadio{this, i};
+
+        radio->commands_available = xSemaphoreCreateBinary();
+        ESP_ERROR_ASSERT(radio->commands_available);
+
+#ifdef CONFIG_DEVICE_TX_BACKEND_RMT
+        ESP_LOGI(TAG, "Transmitting using the RMT peripheral");
+
+        radio->transmitter = new RMTSomfyTransmitter(RADIO_PINS[i].gdo0_pin);
+#endif
+
+#ifdef CONFIG_DEVICE_TX_BACKEND_CC1101_FIFO
+        ESP_LOGI(TAG, "Transmitting using the CC1101 TX FIFO");
+
+        radio->transmitter = new CC1101SomfyTransmitter(RADIO_PINS[i].gdo0_pin);
+#endif
+
+        if (radio->transmitter) {
+            radio->transmitter->setup();
+            // The RMT transmitter reports completion from its interrupt, the CC1101 transmitter from its refill task,
+            // and both from the task that flushes a transmission that has already been sent.
+            radio->transmitter->setDoneCallback(
+                [](void* arg) {
+                    if (!xPortInIsrContext()) {
+                        xTaskNotifyGive(((RemoteRadio*)arg)->task);
+                        return false;
+                    }
+
+                    BaseType_t higher_priority_task_woken = pdFALSE;
+                    vTaskNotifyGiveFromISR(((RemoteRadio*)arg)->task, &higher_priority_task_woken);
+                    return higher_priority_task_woken == pdTRUE;
+                },
+                radio);
+        }
+
+        // The task is started by set_devices, once the devices are known.
+        _radios.push_back(radio);
     }
-    ELECHOUSE_cc1101.setMHZ(433.42);
 
-    ESP_LOGI(TAG, "Successfully initialized the CC1101");
+#ifdef CONFIG_DEVICE_TIMING_STATS
+    ESP_LOGI(TAG, "Measuring transmit timing");
+
+    _timing_stats = new SomfyTimingStats();
+#endif
+
+#ifdef CONFIG_DEVICE_ENABLE_RECEIVER
+    ESP_LOGI(TAG, "Listening for remotes on GDO2");
+
+    _receiver = new GPIOSomfyReceiver(CONFIG_DEVICE_GDO2_PIN);
+    _receiver->setup();
+
+    ELECHOUSE_cc1101.setModul(0);
+    ELECHOUSE_cc1101.SetRx();
+    _receiver->setEnabled(true);
+
+    xTaskCreate([](auto arg) { ((RemoteDeviceManager*)arg)->receive_task(); }, "RemoteDeviceManager::receive_task",
+                CONFIG_ESP_MAIN_TASK_STACK_SIZE, this, 5, nullptr);
+#endif
 
     return ESP_OK;
 }
 
-void RemoteDeviceManager::set_configuration(DeviceConfiguration* configuration) {
-    for (const auto& device : configuration->get_devices()) {
-        _devices.push_back(RemoteDevice(device.get_short_id()));
+void RemoteDeviceManager::set_devices(const vector<RemoteDeviceConfiguration>& devices) {
+    // The radio tasks use the devices without holding a lock, so they can't change once the tasks run.
+    if (_radios.empty() || _radios.front()->task) {
+        ESP_LOGE(TAG, "Devices can only be configured once, after begin");
+        return;
+    }
+
+    {
+        // Keeps queue_command and the scheduler away from the vectors while they grow.
+        lock_guard<mutex> schedule_lock(_schedule_lock);
+        lock_guard<mutex> queue_lock(_queue_lock);
+
+        add_devices(devices);
+    }
+
+    for (const auto radio : _radios) {
+        xTaskCreate([](auto arg) { ((RemoteRadio*)arg)->manager->task((RemoteRadio*)arg); },
+                    "RemoteDeviceManager::task", CONFIG_ESP_MAIN_TASK_STACK_SIZE, radio, 5, &radio->task);
+    }
+}
+
+// Called with _schedule_lock and _queue_lock held.
+void RemoteDeviceManager::add_devices(const vector<RemoteDeviceConfiguration>& devices) {
+    for (const auto& device : devices) {
+        // Devices without a radio are spread over the radios in order.
+        auto radio_index = device.get_radio();
+        if (radio_index < 0 || radio_index >= _radios.size()) {
+            if (radio_index >= 0) {
+                ESP_LOGW(TAG, "Device %s is assigned to radio %d, but there are only %d radios",
+                         device.get_id().c_str(), radio_index, (int)_radios.size());
+            }
+
+            radio_index = int(_devices.size() % _radios.size());
+        }
+
+        ESP_LOGI(TAG, "Sending commands for device %s on radio %d", device.get_id().c_str(), radio_index);
+
+        _devices.push_back(RemoteDevice(device.get_short_id(), _radios[radio_index]->transmitter));
+        _device_radios.push_back(radio_index);
+        _pending_presses.push_back({});
+        _queued_stops.push_back(false);
+        _device_queues.push_back({});
+        _queue_statistics.devices.push_back({});
+
+        if (_timing_stats && _devices.back().is_available()) {
+            _devices.back().set_timing_stats(_timing_stats);
+        }
+    }
+}
+
+bool RemoteDeviceManager::queue_command(int device_id, RemoteCommandId command_id, bool long_press,
+                                        uint32_t received_ms, uint32_t deadline_ms) {
+    if (!is_valid_device(device_id)) {
+        return false;
+    }
+
+    // Long presses are sent as holds, so they can be cut short.
+    const auto hold_ms = long_press ? RemoteDevice::get_long_press_ms(command_id) : 0;
+
+    if (!deadline_ms) {
+        deadline_ms = get_default_deadline_ms(command_id, hold_ms);
+    }
+
+    if (!hold_ms && is_coalescible(command_id)) {
+        // The sequence is assigned by queue_press.
+        return queue_press({device_id, command_id, 0, 0, received_ms, deadline_ms});
+    }
+
+    lock_guard<mutex> lock(_queue_lock);
+
+    return enqueue({device_id, command_id, _devices[device_id].request_command(), hold_ms, received_ms, deadline_ms});
+}
+
+bool RemoteDeviceManager::queue_press(const RemoteCommand& command) {
+    {
+        lock_guard<mutex> lock(_queue_lock);
+
+        auto& pending = _pending_presses[command.device_id];
+
+        if (pending.sequence && pending.command_id == command.command_id) {
+            ESP_LOGI(TAG, "Dropping duplicate command %d for device ID %d", static_cast<int>(command.command_id),
+                     command.device_id);
+
+            _queue_statistics.duplicates++;
+            _queue_statistics.airtime_saved_ms += get_press_airtime_ms();
+        } else {
+            const auto previous = pending;
+
+            // A stop overrides everything requested before it, e.g. a queued down, a long press or a running hold.
+            // They're dropped even when the stop itself can't be queued: not moving is closer to what was asked.
+            if (is_urgent(command.command_id, 0)) {
+                _devices[command.device_id].cancel();
+            }
+
+            // Registered before the command is queued, so the task can't take it before it's known.
+            pending = {_devices[command.device_id].request_command(), command.command_id, command.received_ms,
+                       command.deadline_ms};
+
+            auto queued = command;
+            queued.sequence = pending.sequence;
+
+            // When a stop for the device is still queued, that one is sent as this one. take_command gives it the
+            // sequence of the pending press.
+            const auto merged = is_urgent(command.command_id, 0) && _queued_stops[command.device_id];
+
+            if (!merged && !enqueue(queued)) {
+                if (!can_take_place_of(previous, command.command_id)) {
+                    pending = previous;
+                    return false;
+                }
+
+                // There's no room for the press, so it's sent in place of the queued one.
+                pending.sequence = previous.sequence;
+            } else if (!previous.sequence) {
+                return true;
+            }
+
+            // The previous press stays queued. The task drops it, or sends this press instead when it took its place.
+            ESP_LOGI(TAG, "Command %d supersedes queued command %d for device ID %d",
+                     static_cast<int>(command.command_id), static_cast<int>(previous.command_id), command.device_id);
+
+            _queue_statistics.superseded++;
+            _queue_statistics.airtime_saved_ms += get_press_airtime_ms();
+        }
+    }
+
+    report_queue_statistics();
+
+    return true;
+}
+
+bool RemoteDeviceManager::queue_hold(int device_id, RemoteCommandId command_id, uint32_t duration_ms,
+                                     uint32_t received_ms) {
+    if (!is_valid_device(device_id)) {
+        return false;
+    }
+
+    if (!duration_ms || duration_ms > MAX_HOLD_MS) {
+        duration_ms = MAX_HOLD_MS;
+    }
+
+    lock_guard<mutex> lock(_queue_lock);
+
+    return enqueue({device_id, command_id, _devices[device_id].request_command(), duration_ms, received_ms,
+                    get_default_deadline_ms(command_id, duration_ms)});
+}
+
+void RemoteDeviceManager::stop_hold(int device_id) {
+    if (is_valid_device(device_id)) {
+        _devices[device_id].stop_hold();
+    }
+}
+
+void RemoteDeviceManager::cancel(int device_id) {
+    if (is_valid_device(device_id)) {
+        ESP_LOGI(TAG, "Cancelling commands for device ID %d", device_id);
+
+        lock_guard<mutex> lock(_queue_lock);
+
+        // A press after the cancel must be sent, even if it's the same as the cancelled one.
+        _pending_presses[device_id] = {};
+        _devices[device_id].cancel();
+    }
+}
+
+bool RemoteDeviceManager::is_urgent(RemoteCommandId command_id, uint32_t hold_ms) {
+    // Stopping a blind can't wait for a long press to finish.
+    return command_id == RemoteCommandId::My && !hold_ms;
+}
+
+bool RemoteDeviceManager::is_coalescible(RemoteCommandId command_id) {
+    // Only the latest direction matters for these. Other commands, e.g. Prog, must be sent as often as requested.
+    return command_id == RemoteCommandId::Up || command_id == RemoteCommandId::Down ||
+           command_id == RemoteCommandId::My;
+}
+
+bool RemoteDeviceManager::can_take_place_of(const PendingPress& pending, RemoteCommandId command_id) {
+#ifdef CONFIG_DEVICE_COMMAND_QUEUE_OVERFLOW_COALESCE
+    // The queued press must be in the queue the new one would have gone to.
+    return pending.sequence && is_urgent(pending.command_id, 0) == is_urgent(command_id, 0);
+#else
+    return false;
+#endif
+}
+
+uint32_t RemoteDeviceManager::get_press_airtime_ms() { return SomfyRemote::getCommandDuration() / 1000; }
+
+uint32_t RemoteDeviceManager::get_default_deadline_ms(RemoteCommandId command_id, uint32_t hold_ms) {
+    // Pairing is done by hand and doesn't go stale the way moving a blind does.
+    if (command_id == RemoteCommandId::Prog) {
+        return 0;
+    }
+
+    return hold_ms ? CONFIG_DEVICE_HOLD_DEADLINE_MS : CONFIG_DEVICE_COMMAND_DEADLINE_MS;
+}
+
+// Called with _queue_lock held, which keeps the callers to a single producer of the ring buffers. Never blocks: when
+// the queue is full, the overflow policy decides whether the new command or the oldest queued one is dropped.
+bool RemoteDeviceManager::enqueue(const RemoteCommand& command) {
+    const auto urgent = is_urgent(command.command_id, command.hold_ms);
+    const auto commands = urgent ? _urgent_commands : _commands;
+
+    const auto radio = get_radio(command.device_id);
+
+    // Urgent commands jump the queue. The counter tells a running hold to stop at the next frame boundary.
+    if (urgent) {
+        radio->urgent_pending++;
+        _queued_stops[command.device_id] = true;
+    }
+
+#ifdef CONFIG_DEVICE_COMMAND_QUEUE_OVERFLOW_EVICT
+    optional<RemoteCommand> evicted;
+    const auto queued = commands->push_evict(command, evicted);
+    if (evicted.has_value()) {
+        drop_evicted(evicted.value());
+    }
+#else
+    const auto queued = commands->push(command);
+#endif
+    if (!queued) {
+        if (urgent) {
+            radio->urgent_pending--;
+            _queued_stops[command.device_id] = false;
+        }
+
+        ESP_LOGW(TAG, "Queue full, can't queue command %d for device ID %d", static_cast<int>(command.command_id),
+                 command.device_id);
+        return false;
+    }
+
+    xSemaphoreGive(radio->commands_available);
+
+    return true;
+}
+
+// Called with _queue_lock held.
+void RemoteDeviceManager::drop_evicted(const RemoteCommand& command) {
+    ESP_LOGW(TAG, "Queue full, dropping oldest command %d for device ID %d", static_cast<int>(command.command_id),
+             command.device_id);
+
+    if (is_urgent(command.command_id, command.hold_ms)) {
+        get_radio(command.device_id)->urgent_pending--;
+        _queued_stops[command.device_id] = false;
+    }
+
+    // A press that's no longer queued can't be superseded or duplicated anymore.
+    auto& pending = _pending_presses[command.device_id];
+    if (pending.sequence == command.sequence) {
+        pending = {};
+    }
+}
+
+// Called with _schedule_lock held.
+void RemoteDeviceManager::receive_queued_commands() {
+    RemoteCommand command;
+    while (_urgent_commands->pop(command)) {
+        _urgent_queue.push_back(command);
+    }
+
+    // Limiting the scheduled commands to the depth of the ring buffer keeps the overflow policy in effect.
+    while (_scheduled_count < _commands->capacity() * _radios.size() && _commands->pop(command)) {
+        _device_queues[command.device_id].push_back(command);
+        _scheduled_count++;
+    }
+}
+
+uint32_t RemoteDeviceManager::get_job_ms(const RemoteCommand& command) {
+    return command.hold_ms ? command.hold_ms : get_press_airtime_ms();
+}
+
+// Called with _schedule_lock held.
+int RemoteDeviceManager::schedule_device(const function<bool(const RemoteCommand&)>& predicate) {
+    const auto now = esp_get_millis();
+    const auto device_count = int(_device_queues.size());
+    auto best_device_id = -1;
+    uint64_t best_wait_ms = 0;
+    uint64_t best_job_ms = 1;
+
+    // Only the oldest command of a device is considered, so the commands for a single device keep their order.
+    // Devices are visited round-robin, starting after the last one that was served, so devices with commands of the
+    // same length take turns.
+    for (int i = 1; i <= device_count; i++) {
+        const auto device_id = (_last_device_id + i) % device_count;
+        const auto& queue = _device_queues[device_id];
+
+        if (queue.empty() || !predicate(queue.front())) {
+            continue;
+        }
+
+        // Highest response ratio next, i.e. (wait + job) / job. Short presses overtake long presses and holds, but
+        // the ratio of a long command grows while it waits, so it can't be starved.
+        const uint64_t wait_ms = now - queue.front().received_ms;
+        const uint64_t job_ms = get_job_ms(queue.front());
+
+        if (best_device_id < 0 || (wait_ms + job_ms) * best_job_ms > (best_wait_ms + best_job_ms) * job_ms) {
+            best_device_id = device_id;
+            best_wait_ms = wait_ms;
+            best_job_ms = job_ms;
+        }
+    }
+
+    return best_device_id;
+}
+
+bool RemoteDeviceManager::pop_command_if(RemoteCommand& command,
+                                         const function<bool(const RemoteCommand&)>& predicate) {
+    lock_guard<mutex> lock(_schedule_lock);
+
+    receive_queued_commands();
+
+    // Urgent commands go before everything else.
+    for (auto it = _urgent_queue.begin(); it != _urgent_queue.end(); it++) {
+        if (predicate(*it)) {
+            command = *it;
+            _urgent_queue.erase(it);
+            return true;
+        }
+    }
+
+    const auto device_id = schedule_device(predicate);
+    if (device_id < 0) {
+        return false;
+    }
+
+    auto& queue = _device_queues[device_id];
+    command = queue.front();
+    queue.erase(queue.begin());
+
+    _scheduled_count--;
+    _last_device_id = device_id;
+
+    return true;
+}
+
+bool RemoteDeviceManager::peek_command(RemoteCommand& command,
+                                       const function<bool(const RemoteCommand&)>& predicate) {
+    lock_guard<mutex> lock(_schedule_lock);
+
+    receive_queued_commands();
+
+    for (const auto& urgent_command : _urgent_queue) {
+        if (predicate(urgent_command)) {
+            command = urgent_command;
+            return true;
+        }
+    }
+
+    const auto device_id = schedule_device(predicate);
+    if (device_id < 0) {
+        return false;
     }
+
+    command = _device_queues[device_id].front();
+
+    return true;
 }
 
-bool RemoteDeviceManager::queue_command(int device_id, RemoteCommandId command_id, bool long_press) {
-    auto command = RemoteCommand{device_id, command_id, long_press};
+bool RemoteDeviceManager::take_command(RemoteCommand& command) {
+    if (!is_valid_device(command.device_id)) {
+        return false;
+    }
+
+    if (is_urgent(command.command_id, command.hold_ms)) {
+        get_radio(command.device_id)->urgent_pending--;
+    }
+
+    if (!command.hold_ms && is_coalescible(command.command_id)) {
+        lock_guard<mutex> lock(_queue_lock);
+
+        auto& pending = _pending_presses[command.device_id];
+
+        // Stops queued while this one waited were merged into it, so it's sent as the latest of them.
+        if (is_urgent(command.command_id, 0)) {
+            _queued_stops[command.device_id] = false;
+
+            if (is_urgent(pending.command_id, 0)) {
+                command.sequence = pending.sequence;
+            }
+        }
+
+        if (pending.sequence != command.sequence) {
+            ESP_LOGI(TAG, "Dropping superseded command %d for device ID %d", static_cast<int>(command.command_id),
+                     command.device_id);
+            return false;
+        }
+
+        // A later press may have taken the place of this one.
+        command.command_id = pending.command_id;
+        command.received_ms = pending.received_ms;
+        command.deadline_ms = pending.deadline_ms;
+
+        pending = {};
+    }
+
+    if (_devices[command.device_id].is_cancelled(command.sequence)) {
+        ESP_LOGI(TAG, "Dropping cancelled command %d for device ID %d", static_cast<int>(command.command_id),
+                 command.device_id);
+        return false;
+    }
+
+    const auto latency_ms = esp_get_millis() - command.received_ms;
+
+    lock_guard<mutex> lock(_queue_lock);
 
-    if (xQueueSend(_queue, &command, pdMS_TO_TICKS(50)) != pdPASS) {
-        ESP_LOGW(TAG, "Queue full, dropping command");
+    if (command.deadline_ms && latency_ms > command.deadline_ms) {
+        ESP_LOGW(TAG, "Dropping command %d for device ID %d, it missed its deadline by %" PRIu32 " ms",
+                 static_cast<int>(command.command_id), command.device_id, latency_ms - command.deadline_ms);
+
+        _queue_statistics.expired++;
         return false;
     }
 
+    _queue_statistics.sent++;
+    _queue_statistics.latency_total_ms += latency_ms;
+    if (latency_ms > _queue_statistics.latency_max_ms) {
+        _queue_statistics.latency_max_ms = latency_ms;
+    }
+
+    auto& device = _queue_statistics.devices[command.device_id];
+    device.sent++;
+    device.wait_total_ms += latency_ms;
+    if (latency_ms > device.wait_max_ms) {
+        device.wait_max_ms = latency_ms;
+    }
+
     return true;
 }
 
-void RemoteDeviceManager::task() {
+void RemoteDeviceManager::task(RemoteRadio* radio) {
+    auto on_radio = [this, radio](const RemoteCommand& command) { return get_radio(command.device_id) == radio; };
+
     RemoteCommand command;
 
     while (true) {
-        if (xQueueReceive(_queue, &command, portMAX_DELAY) == pdTRUE) {
-            send_command(command.device_id, command.command_id, command.long_press);
+        if (!pop_command_if(command, on_radio)) {
+            xSemaphoreTake(radio->commands_available, portMAX_DELAY);
+            continue;
         }
+
+        if (take_command(command)) {
+            if (command.hold_ms) {
+                send_hold(radio, command);
+            } else if (radio->transmitter) {
+                send_session(radio, command);
+            } else {
+                send_command(radio, command.device_id, command.command_id);
+            }
+        }
+
+        report_queue_statistics();
     }
 }
 
-void RemoteDeviceManager::send_command(int device_id, RemoteCommandId command_id, bool long_press) {
+bool RemoteDeviceManager::is_valid_device(int device_id) {
     if (device_id < 0 || device_id >= _devices.size()) {
         ESP_LOGE(TAG, "Invalid device ID %d", device_id);
-    } else {
-        ESP_LOGI(TAG, "Sending command %d to device ID %d long press %s", static_cast<int>(command_id), device_id,
-                 long_press ? "yes" : "no");
+        return false;
+    }
+
+    if (!_devices[device_id].is_available()) {
+        ESP_LOGE(TAG, "Device ID %d has no remote, not sending commands for it", device_id);
+        return false;
+    }
+
+    return true;
+}
+
+void RemoteDeviceManager::send_session(RemoteRadio* radio, const RemoteCommand& first_command) {
+    SomfySession session(radio->transmitter, SESSION_FRAME_GAP_US);
+    vector<int> device_ids;
+
+    auto add_command = [&](const RemoteCommand& command) {
+        ESP_LOGI(TAG, "Sending command %d to device ID %d", static_cast<int>(command.command_id), command.device_id);
+
+        if (!_devices[command.device_id].add_to_session(session, command.command_id)) {
+            ESP_LOGW(TAG, "Could not add command for device ID %d to session", command.device_id);
+            return;
+        }
+
+        device_ids.push_back(command.device_id);
+    };
+
+    auto has_device = [&](int device_id) {
+        for (const auto id : device_ids) {
+            if (id == device_id) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    add_command(first_command);
+
+    // Send everything that has been queued in the meantime in the same session. A second command for a device
+    // stays queued for the next session, so the commands for a single device keep their order.
+    auto can_join = [&](const RemoteCommand& command) {
+        return get_radio(command.device_id) == radio && !command.hold_ms && !has_device(command.device_id);
+    };
+
+    RemoteCommand command;
+    while (session.size() < SomfySession::CAPACITY && pop_command_if(command, can_join)) {
+        if (take_command(command)) {
+            add_command(command);
+        }
+    }
 
-        ELECHOUSE_cc1101.SetTx();
+    if (!session.size()) {
+        return;
+    }
+
+    // Drop completions of earlier transmissions that weren't waited for using the notification.
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    begin_transmit(radio);
+
+    session.start();
+
+    // The frames are clocked out by the RMT peripheral, so the time on the air can be used to get the next
+    // command ready.
+    prepare_queued_command(radio, device_ids);
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    end_transmit(radio);
+
+    // The rolling codes have moved on; render the frames for the next ones while the radio is idle.
+    for (const auto device_id : device_ids) {
+        _devices[device_id].prepare();
+    }
+}
+
+void RemoteDeviceManager::prepare_queued_command(RemoteRadio* radio, const vector<int>& busy_device_ids) {
+    // Only the devices of this radio may be touched; the others are owned by the tasks of their radios.
+    auto on_radio = [this, radio](const RemoteCommand& command) { return get_radio(command.device_id) == radio; };
+
+    RemoteCommand command;
+    if (!peek_command(command, on_radio)) {
+        return;
+    }
+
+    // The frames of the devices on the air must stay as they are until the transmission completes.
+    for (const auto device_id : busy_device_ids) {
+        if (device_id == command.device_id) {
+            return;
+        }
+    }
+
+    _devices[command.device_id].prepare_command(command.command_id);
+}
+
+void RemoteDeviceManager::send_hold(RemoteRadio* radio, const RemoteCommand& command) {
+    ESP_LOGI(TAG, "Holding command %d on device ID %d for at most %" PRIu32 " ms",
+             static_cast<int>(command.command_id), command.device_id, command.hold_ms);
+
+    begin_transmit(radio);
+
+    _devices[command.device_id].hold_command(command.command_id, command.sequence, command.hold_ms,
+                                             [radio]() { return radio->urgent_pending > 0; });
+
+    end_transmit(radio);
+
+    // The remainder of a hold preempted by a stop for another device is dropped, not queued again. Resuming would
+    // send a new press with the next rolling code, which the motor doesn't see as the same long press; a long My
+    // that reverses the direction of a motor would then do nothing. Holds stopped by a stop for this device were
+    // cancelled instead.
+    if (radio->urgent_pending > 0 && !_devices[command.device_id].is_cancelled(command.sequence)) {
+        ESP_LOGW(TAG, "Hold on device ID %d preempted by an urgent command, dropping the rest of it",
+                 command.device_id);
+    }
+
+    _devices[command.device_id].prepare();
+
+    report_transmit_timing();
+}
+
+void RemoteDeviceManager::send_command(RemoteRadio* radio, int device_id, RemoteCommandId command_id) {
+    ESP_LOGI(TAG, "Sending command %d to device ID %d", static_cast<int>(command_id), device_id);
+
+    begin_transmit(radio);
+
+    _devices[device_id].send_command(command_id);
+
+    end_transmit(radio);
+
+    // The rolling code has moved on; render the frames for the next one while the radio is idle.
+    _devices[device_id].prepare();
+
+    report_transmit_timing();
+}
+
+void RemoteDeviceManager::begin_transmit(RemoteRadio* radio) {
+    lock_guard<mutex> lock(_radio_lock);
 
-        _devices[device_id].send_command(command_id, long_press);
+    // The receiver would pick up the transmissions of all radios, not just those of its own.
+    if (_receiver && !_transmitting) {
+        _receiver->setEnabled(false);
+    }
+
+    _transmitting++;
+
+    ELECHOUSE_cc1101.setModul(radio->index);
+
+#ifndef CONFIG_DEVICE_TX_BACKEND_CC1101_FIFO
+    // The FIFO transmitter switches the radio to TX itself, once it has been configured for packet mode.
+    ELECHOUSE_cc1101.SetTx();
+#endif
+}
 
+void RemoteDeviceManager::end_transmit(RemoteRadio* radio) {
+    lock_guard<mutex> lock(_radio_lock);
+
+    _transmitting--;
+
+    // The first radio goes back to receiving once all radios are done, even when it finished earlier.
+    const auto receive = _receiver && !_transmitting;
+
+    if (!receive || radio->index != 0) {
+        ELECHOUSE_cc1101.setModul(radio->index);
         ELECHOUSE_cc1101.setSidle();
     }
+
+    if (receive) {
+        ELECHOUSE_cc1101.setModul(0);
+        ELECHOUSE_cc1101.SetRx();
+        _receiver->setEnabled(true);
+    }
+}
+
+void RemoteDeviceManager::report_transmit_timing() {
+    if (!_timing_stats || !_transmit_timing_changed) {
+        return;
+    }
+
+    TransmitTimingStatistics statistics;
+
+    for (int i = 0; i < TransmitTimingStatistics::PULSE_KIND_COUNT; i++) {
+        const auto& histogram = _timing_stats->getHistogram(static_cast<SomfyPulseKind>(i));
+
+        statistics.pulses[i] = {histogram.getPercentile(50), histogram.getPercentile(99), histogram.max};
+    }
+
+    ESP_LOGI(TAG, "Symbol timing error p50 %" PRIu32 " us p99 %" PRIu32 " us max %" PRIu32 " us",
+             statistics.pulses[0].p50_us, statistics.pulses[0].p99_us, statistics.pulses[0].max_us);
+
+    _transmit_timing_changed(statistics);
+}
+
+void RemoteDeviceManager::report_queue_statistics() {
+    if (!_queue_statistics_changed) {
+        return;
+    }
+
+    CommandQueueStatistics statistics;
+    {
+        lock_guard<mutex> lock(_queue_lock);
+        statistics = _queue_statistics;
+    }
+
+    // The urgent queue only ever holds a few stops, so the high-water mark is that of the regular queue.
+    statistics.high_water_mark = _commands->high_water_mark();
+    statistics.overflows = _commands->overflows() + _urgent_commands->overflows();
+
+    _queue_statistics_changed(statistics);
+}
+
+void RemoteDeviceManager::receive_task() {
+    SomfyFrameContents frame;
+    SomfyFrameContents last_frame{};
+    uint32_t last_frame_time = 0;
+
+    while (true) {
+        while (_receiver->poll(frame)) {
+            const auto now = esp_get_millis();
+            if (frame.remote == last_frame.remote && frame.code == last_frame.code &&
+                now - last_frame_time < RECEIVE_REPEAT_WINDOW_MS) {
+                last_frame_time = now;
+                continue;
+            }
+
+            last_frame = frame;
+            last_frame_time = now;
+
+            ESP_LOGI(TAG, "Received command %d from remote %06" PRIX32 " rolling code %d",
+                     static_cast<int>(frame.command), frame.remote, frame.code);
+
+            if (_command_received) {
+                _command_received({frame.remote, static_cast<RemoteCommandId>(frame.command), frame.code});
+            }
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(RECEIVE_POLL_INTERVAL_MS));
+    }
 }
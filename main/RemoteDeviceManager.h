@@ -1,23 +1,127 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <vector>
 
 #include "DeviceConfiguration.h"
+#include "DeviceState.h"
 #include "RemoteDevice.h"
-#include "freertos/queue.h"
+#include "RingBuffer.h"
+#include "freertos/semphr.h"
+
+class GPIOSomfyReceiver;
+class RemoteDeviceManager;
+class SomfyTimingStats;
+
+struct RemoteCommand {
+    int device_id;
+    RemoteCommandId command_id;
+    uint32_t sequence;
+    uint32_t hold_ms;
+    uint32_t received_ms;
+    // The command is dropped when it can't be sent within this many milliseconds of being received. Zero for no
+    // deadline.
+    uint32_t deadline_ms;
+};
+
+// The last short press queued for a device, which is superseded when a different press is queued before it's sent.
+// When the queue is full, a later press may take the place of the queued one; it's then sent with the command ID
+// and timestamps stored here.
+struct PendingPress {
+    uint32_t sequence;
+    RemoteCommandId command_id;
+    uint32_t received_ms;
+    uint32_t deadline_ms;
+};
+
+// A CC1101 module with its own transmitter and task, so that the radios transmit concurrently. Every device is
+// assigned to one radio, which sends all of its commands.
+struct RemoteRadio {
+    RemoteDeviceManager* manager;
+    int index;
+    SomfyTransmitter* transmitter;
+    TaskHandle_t task;
+    SemaphoreHandle_t commands_available;
+    // Urgent commands queued for the devices of the radio. Tells a running hold to stop at the next frame boundary;
+    // the rest of the hold is dropped.
+    atomic<int> urgent_pending;
+};
 
 class RemoteDeviceManager {
     vector<RemoteDevice> _devices;
-    QueueHandle_t _queue;
+    vector<RemoteRadio*> _radios;
+    // Indexed by device ID.
+    vector<int> _device_radios;
+    // Urgent commands have their own queue, which is drained first.
+    RingBuffer<RemoteCommand>* _commands;
+    RingBuffer<RemoteCommand>* _urgent_commands;
+    // Commands taken from the ring buffers by the radio tasks, waiting to be scheduled. Protected by
+    // _schedule_lock, which also keeps the radio tasks to a single consumer of the ring buffers.
+    mutex _schedule_lock;
+    vector<RemoteCommand> _urgent_queue;
+    vector<vector<RemoteCommand>> _device_queues;
+    uint32_t _scheduled_count{};
+    int _last_device_id{-1};
+    // The CC1101 driver addresses one module at a time.
+    mutex _radio_lock;
+    int _transmitting{};
+    GPIOSomfyReceiver* _receiver{};
+    SomfyTimingStats* _timing_stats{};
+    mutex _queue_lock;
+    vector<PendingPress> _pending_presses;
+    // Indexed by device ID. Whether the urgent ring buffer holds a stop for the device.
+    vector<bool> _queued_stops;
+    CommandQueueStatistics _queue_statistics{};
+    function<void(ReceivedRemoteCommand)> _command_received;
+    function<void(const TransmitTimingStatistics&)> _transmit_timing_changed;
+    function<void(const CommandQueueStatistics&)> _queue_statistics_changed;
 
 public:
     RemoteDeviceManager();
 
     esp_err_t begin();
-    void set_configuration(DeviceConfiguration* configuration);
-    bool queue_command(int device_id, RemoteCommandId command_id, bool long_press);
+    void set_devices(const vector<RemoteDeviceConfiguration>& devices);
+    bool queue_command(int device_id, RemoteCommandId command_id, bool long_press, uint32_t received_ms,
+                       uint32_t deadline_ms);
+    bool queue_hold(int device_id, RemoteCommandId command_id, uint32_t duration_ms, uint32_t received_ms);
+    void stop_hold(int device_id);
+    void cancel(int device_id);
+    void on_command_received(function<void(ReceivedRemoteCommand)> func) { _command_received = func; }
+    void on_transmit_timing_changed(function<void(const TransmitTimingStatistics&)> func) {
+        _transmit_timing_changed = func;
+    }
+    void on_queue_statistics_changed(function<void(const CommandQueueStatistics&)> func) {
+        _queue_statistics_changed = func;
+    }
 
 private:
-    void task();
-    void send_command(int device_id, RemoteCommandId command_id, bool long_press);
+    void add_devices(const vector<RemoteDeviceConfiguration>& devices);
+    void task(RemoteRadio* radio);
+    bool is_valid_device(int device_id);
+    RemoteRadio* get_radio(int device_id) { return _radios[_device_radios[device_id]]; }
+    static bool is_urgent(RemoteCommandId command_id, uint32_t hold_ms);
+    static bool is_coalescible(RemoteCommandId command_id);
+    static bool can_take_place_of(const PendingPress& pending, RemoteCommandId command_id);
+    static uint32_t get_press_airtime_ms();
+    static uint32_t get_default_deadline_ms(RemoteCommandId command_id, uint32_t hold_ms);
+    bool queue_press(const RemoteCommand& command);
+    bool enqueue(const RemoteCommand& command);
+    void drop_evicted(const RemoteCommand& command);
+    void receive_queued_commands();
+    static uint32_t get_job_ms(const RemoteCommand& command);
+    int schedule_device(const function<bool(const RemoteCommand&)>& predicate);
+    bool pop_command_if(RemoteCommand& command, const function<bool(const RemoteCommand&)>& predicate);
+    bool peek_command(RemoteCommand& command, const function<bool(const RemoteCommand&)>& predicate);
+    bool take_command(RemoteCommand& command);
+    void send_session(RemoteRadio* radio, const RemoteCommand& first_command);
+    void send_hold(RemoteRadio* radio, const RemoteCommand& command);
+    void prepare_queued_command(RemoteRadio* radio, const vector<int>& busy_device_ids);
+    void receive_task();
+    void begin_transmit(RemoteRadio* radio);
+    void end_transmit(RemoteRadio* radio);
+    void report_transmit_timing();
+    void report_queue_statistics();
+    void send_command(RemoteRadio* radio, int device_id, RemoteCommandId command_id);
 };
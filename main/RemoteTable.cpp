@@ -0,0 +1,152 @@
+#include "support.h"
+
+#include "RemoteTable.h"
+
+#include <stddef.h>
+
+LOG_TAG(RemoteTable);
+
+uint32_t RemoteTable::hash_device_id(const string& device_id) {
+    // FNV-1a.
+    uint32_t hash = 2166136261;
+    for (auto c : device_id) {
+        hash = (hash ^ (uint8_t)c) * 16777619;
+    }
+    return hash;
+}
+
+esp_err_t RemoteTable::load() {
+    lock_guard<mutex> lock(_lock);
+
+    _loaded = false;
+
+    size_t length = sizeof(_blob);
+    auto err = nvs_get_blob(_handle, _key, &_blob, &length);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "No remote table stored yet");
+        _blob = {.version = VERSION};
+        _loaded = true;
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Reading remote table failed with error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // This is the first version of the table. A later one is converted here; one written by newer firmware can't
+    // be.
+    if (length < offsetof(Blob, entries) || _blob.version != VERSION) {
+        ESP_LOGE(TAG, "Remote table has unsupported version %" PRIu16, _blob.version);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (_blob.count > MAX_ENTRIES || length != offsetof(Blob, entries) + _blob.count * sizeof(RemoteTableEntry)) {
+        ESP_LOGE(TAG, "Remote table of %" PRIu16 " remotes has invalid length %d", _blob.count, (int)length);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ESP_LOGI(TAG, "Loaded %" PRIu16 " remotes", _blob.count);
+
+    _loaded = true;
+    return ESP_OK;
+}
+
+bool RemoteTable::is_loaded() {
+    lock_guard<mutex> lock(_lock);
+
+    return _loaded;
+}
+
+optional<RemoteTableEntry> RemoteTable::find(uint32_t device_hash) {
+    lock_guard<mutex> lock(_lock);
+
+    if (!_loaded) {
+        return {};
+    }
+
+    for (size_t i = 0; i < _blob.count; i++) {
+        if (_blob.entries[i].device_hash == device_hash) {
+            return _blob.entries[i];
+        }
+    }
+
+    return {};
+}
+
+vector<uint32_t> RemoteTable::get_remote_ids() {
+    lock_guard<mutex> lock(_lock);
+
+    vector<uint32_t> result;
+    if (_loaded) {
+        for (size_t i = 0; i < _blob.count; i++) {
+            result.push_back(_blob.entries[i].remote_id);
+        }
+    }
+
+    return result;
+}
+
+bool RemoteTable::put(const RemoteTableEntry& entry) {
+    lock_guard<mutex> lock(_lock);
+
+    return update(entry) && save();
+}
+
+bool RemoteTable::stage(const RemoteTableEntry& entry) {
+    lock_guard<mutex> lock(_lock);
+
+    return update(entry);
+}
+
+bool RemoteTable::commit() {
+    lock_guard<mutex> lock(_lock);
+
+    return _saved || save();
+}
+
+bool RemoteTable::is_saved() {
+    lock_guard<mutex> lock(_lock);
+
+    return _saved;
+}
+
+bool RemoteTable::update(const RemoteTableEntry& entry) {
+    // Writing would replace the stored table, which may still hold the only copy of the rolling codes.
+    if (!_loaded) {
+        ESP_LOGE(TAG, "Remote table wasn't loaded, not saving remote %06" PRIX32, entry.remote_id);
+        return false;
+    }
+
+    size_t index = 0;
+    while (index < _blob.count && _blob.entries[index].device_hash != entry.device_hash) {
+        index++;
+    }
+
+    if (index == _blob.count) {
+        if (index == MAX_ENTRIES) {
+            ESP_LOGE(TAG, "Remote table is full");
+            return false;
+        }
+        _blob.count++;
+    }
+
+    _blob.entries[index] = entry;
+    _saved = false;
+
+    return true;
+}
+
+bool RemoteTable::save() {
+    const auto length = offsetof(Blob, entries) + _blob.count * sizeof(RemoteTableEntry);
+
+    auto err = nvs_set_blob(_handle, _key, &_blob, length);
+    if (err == ESP_OK) {
+        err = nvs_commit(_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Saving remote table failed with error %s", esp_err_to_name(err));
+        return false;
+    }
+
+    _saved = true;
+    return true;
+}
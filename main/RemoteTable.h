@@ -0,0 +1,66 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "RollingCodeBatch.h"
+
+struct RemoteTableEntry {
+    uint32_t device_hash;
+    uint32_t remote_id;
+    uint16_t rolling_code;
+    uint16_t reserved;
+};
+
+// Remote IDs and rolling codes of all devices, stored as a single versioned NVS blob. The blob is read once at
+// startup and every change writes it back as a whole, so the NVS entry count doesn't grow with the number of
+// devices.
+//
+// The flip side is wear: a write takes one NVS entry per 32 bytes of the blob, about one per three devices, where a
+// key per device took one. CONFIG_DEVICE_ROLLING_CODE_BLOCK is sized so that the table isn't written more often than
+// once per 32 commands of a device.
+//
+// A blob that can't be read is never replaced. The table then refuses all changes and the devices refuse to
+// transmit, because rebuilding it from the keys of older firmware would reuse rolling codes the motors have
+// already seen.
+//
+// As a batch, the table takes the rolling codes the write-behind flusher reserves for all devices and saves them
+// with a single write.
+class RemoteTable : public RollingCodeBatch {
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t MAX_ENTRIES = 64;
+
+    struct Blob {
+        uint16_t version;
+        uint16_t count;
+        RemoteTableEntry entries[MAX_ENTRIES];
+    };
+
+    nvs_handle_t _handle;
+    const char* _key;
+    Blob _blob{};
+    bool _loaded{};
+    // Whether the stored blob matches the one in memory, which a failed save or a staged entry changes.
+    bool _saved{true};
+    mutex _lock;
+
+public:
+    RemoteTable(nvs_handle_t handle, const char* key) : _handle(handle), _key(key) {}
+
+    static uint32_t hash_device_id(const string& device_id);
+
+    esp_err_t load();
+    bool is_loaded();
+    optional<RemoteTableEntry> find(uint32_t device_hash);
+    bool put(const RemoteTableEntry& entry);
+    // Like put, but leaves saving the table to the next commit.
+    bool stage(const RemoteTableEntry& entry);
+    bool commit() override;
+    bool is_saved();
+    vector<uint32_t> get_remote_ids();
+
+private:
+    bool update(const RemoteTableEntry& entry);
+    bool save();
+};
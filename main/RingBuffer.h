@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+
+// Fixed capacity queue between a single producer and a single consumer task that never blocks either of them. The
+// capacity is rounded up to a power of two, so the free running indices can be masked into the slots.
+//
+// When the queue is full, the producer may make room by evicting the oldest item, which makes it a second consumer.
+// Like in Vyukov's bounded queue, every slot has a sequence number that hands it between the producer and the
+// consumers: whoever claims the head with a compare and swap owns the slot until it has copied the item out, and
+// the producer only writes a slot once it's been handed back. No item is ever read while it's written.
+//
+// There are twice as many slots as the capacity. A consumer that's preempted while copying an item out holds on to
+// its slot, and the spare slots let the producer go on queueing around it.
+template <typename T>
+class RingBuffer {
+    // Keeps the indices that are written by different tasks out of each other's cache line.
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    struct Slot {
+        // The index the slot can be written at when it's equal to it, and read at when it's one less.
+        atomic<uint32_t> sequence;
+        T item;
+    };
+
+    unique_ptr<Slot[]> _slots;
+    uint32_t _capacity;
+    uint32_t _mask;
+    // Written by the consumer, and by the producer when it evicts an item.
+    alignas(CACHE_LINE_SIZE) atomic<uint32_t> _head{};
+    // Written by the producer only.
+    alignas(CACHE_LINE_SIZE) atomic<uint32_t> _tail{};
+    atomic<uint32_t> _high_water_mark{};
+    atomic<uint32_t> _overflows{};
+
+public:
+    explicit RingBuffer(uint32_t capacity) {
+        uint32_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _capacity = size;
+        _mask = 2 * size - 1;
+        _slots = make_unique<Slot[]>(2 * size);
+        for (uint32_t i = 0; i < 2 * size; i++) {
+            _slots[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    uint32_t capacity() const { return _capacity; }
+
+    uint32_t size() const {
+        // The head is read first. The tail only moves forward, so it can't end up before the head.
+        const auto head = _head.load(memory_order_acquire);
+        return _tail.load(memory_order_acquire) - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Most items that have been queued at the same time.
+    uint32_t high_water_mark() const { return _high_water_mark.load(memory_order_relaxed); }
+
+    // Items that were rejected or evicted because the queue was full.
+    uint32_t overflows() const { return _overflows.load(memory_order_relaxed); }
+
+    // Producer only. Returns false when the queue is full.
+    bool push(const T& item) {
+        const auto tail = _tail.load(memory_order_relaxed);
+
+        if (tail - _head.load(memory_order_acquire) >= _capacity || !store(tail, item)) {
+            _overflows.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Producer only. Makes room by evicting the oldest item when the queue is full, which is then copied into
+    // evicted. Returns false when the item couldn't be queued all the same, because a consumer that's been
+    // preempted while taking an item still holds the slot it's going into.
+    bool push_evict(const T& item, optional<T>& evicted) {
+        const auto tail = _tail.load(memory_order_relaxed);
+        const auto head = _head.load(memory_order_acquire);
+
+        // Nothing is evicted when the consumer takes the oldest item in the meantime.
+        T oldest;
+        if (tail - head >= _capacity && take(head, oldest)) {
+            _overflows.fetch_add(1, memory_order_relaxed);
+            evicted = oldest;
+        }
+
+        if (!store(tail, item)) {
+            _overflows.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Consumer only.
+    bool pop(T& item) {
+        auto head = _head.load(memory_order_acquire);
+
+        while (head != _tail.load(memory_order_acquire)) {
+            if (take(head, item)) {
+                return true;
+            }
+
+            // The producer evicted the item.
+            head = _head.load(memory_order_acquire);
+        }
+
+        return false;
+    }
+
+private:
+    bool store(uint32_t tail, const T& item) {
+        auto& slot = _slots[tail & _mask];
+        if (slot.sequence.load(memory_order_acquire) != tail) {
+            return false;
+        }
+
+        slot.item = item;
+        slot.sequence.store(tail + 1, memory_order_release);
+        _tail.store(tail + 1, memory_order_release);
+
+        const auto size = tail + 1 - _head.load(memory_order_relaxed);
+        if (size > _high_water_mark.load(memory_order_relaxed)) {
+            _high_water_mark.store(size, memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Takes the item at head, unless another consumer took it first.
+    bool take(uint32_t head, T& item) {
+        auto& slot = _slots[head & _mask];
+        if (slot.sequence.load(memory_order_acquire) != head + 1 ||
+            !_head.compare_exchange_strong(head, head + 1, memory_order_acq_rel, memory_order_relaxed)) {
+            return false;
+        }
+
+        item = slot.item;
+        // Hands the slot back to the producer for the index a lap further on.
+        slot.sequence.store(head + _mask + 1, memory_order_release);
+        return true;
+    }
+};
@@ -0,0 +1,195 @@
+"""Analyzes a captured Somfy RTS transmission.
+
+Reads either an edge trace, e.g. a sigrok / logic analyzer CSV export with a
+time column and a level column, or a pulse list of level,duration pairs as
+produced by SomfyRecorderOutput. Reports the timing error per segment of the
+transmission, the frames that could be decoded and the total airtime.
+
+The frames are decoded with the somfy-decode tool from the host build in
+test/, see test/CMakeLists.txt.
+
+Usage: python analyze-trace.py [--time-unit s|ms|us] [--channel N] [--decoder path] trace.csv
+"""
+
+import argparse
+import csv
+import os
+import statistics
+import subprocess
+import sys
+
+SYMBOL = 640
+HALF_SYMBOL_TOLERANCE = 0.25
+
+# Nominal durations in microseconds per segment. Data pulses are one or two
+# half symbols; their nominal duration is the nearest multiple of SYMBOL.
+SEGMENTS = [
+    ("wake_up", 1, 9415),
+    ("wake_up_silence", 0, 9565 + 80000),
+    ("hardware_sync", 1, 4 * SYMBOL),
+    ("hardware_sync", 0, 4 * SYMBOL),
+    ("software_sync", 1, 4550),
+    ("inter_frame_silence", 0, 415 + 30000),
+    # The silence merges with the last half symbol when that is low.
+    ("inter_frame_silence", 0, SYMBOL + 415 + 30000),
+]
+
+COMMANDS = {
+    0x1: "my",
+    0x2: "up",
+    0x3: "my_up",
+    0x4: "down",
+    0x5: "my_down",
+    0x6: "up_down",
+    0x8: "prog",
+    0x9: "sun_flag",
+    0xA: "flag",
+}
+
+TIME_UNITS = {"s": 1e6, "ms": 1e3, "us": 1}
+
+DEFAULT_DECODER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "build-host", "somfy-decode")
+
+
+def read_pulses(path, time_unit, channel):
+    """Returns the trace as a list of (level, duration in microseconds)."""
+
+    with open(path, newline="") as file:
+        rows = [row for row in csv.reader(file) if row and not row[0].startswith(";")]
+
+    header = None
+    if rows and not _is_number(rows[0][0]):
+        header = [column.strip().lower() for column in rows[0]]
+        rows = rows[1:]
+
+    if header and header[0].startswith("time"):
+        return _edges_to_pulses(rows, TIME_UNITS[time_unit], channel)
+
+    return [(int(float(row[0])) != 0, float(row[1])) for row in rows]
+
+
+def _is_number(value):
+    try:
+        float(value)
+        return True
+    except ValueError:
+        return False
+
+
+def _edges_to_pulses(rows, scale, channel):
+    pulses = []
+    start = None
+    level = None
+
+    for row in rows:
+        time = float(row[0]) * scale
+        value = int(float(row[channel])) != 0
+        if level is None:
+            start, level = time, value
+        elif value != level:
+            pulses.append((level, time - start))
+            start, level = time, value
+
+    return pulses
+
+
+def classify(level, duration):
+    """Returns the segment and nominal duration of a pulse."""
+
+    best = None
+    for name, segment_level, nominal in SEGMENTS:
+        if segment_level == level and abs(duration - nominal) < nominal * 0.2:
+            if best is None or abs(duration - nominal) < abs(duration - best[1]):
+                best = (name, nominal)
+    if best:
+        return best
+
+    half_symbols = round(duration / SYMBOL)
+    if 1 <= half_symbols <= 2 and abs(duration - half_symbols * SYMBOL) < SYMBOL * HALF_SYMBOL_TOLERANCE * 2:
+        return ("symbol", half_symbols * SYMBOL)
+
+    return ("unknown", None)
+
+
+def decode_frames(pulses, decoder):
+    """Yields (frame, command, rolling code, remote) for the valid frames in the trace.
+
+    The frames are decoded by somfy-decode, a host build of the decoder the
+    firmware runs on received signals, so the trace is checked against the
+    same code. Frames failing the checksum are skipped by the decoder.
+    """
+
+    pulse_list = "".join(f"{int(level)},{duration:.0f}\n" for level, duration in pulses)
+    try:
+        result = subprocess.run([decoder], input=pulse_list, capture_output=True, text=True, check=True)
+    except FileNotFoundError:
+        sys.exit(f"Decoder {decoder} not found; build it with: cmake -S test -B build-host && cmake --build build-host")
+
+    for line in result.stdout.splitlines():
+        frame, command, code, remote = line.split(",")
+        yield frame, int(command), int(code), int(remote, 16)
+
+
+def report_timing(pulses):
+    errors = {}
+    for level, duration in pulses:
+        name, nominal = classify(level, duration)
+        if nominal is not None:
+            errors.setdefault(name, []).append(duration - nominal)
+
+    print("Timing error per segment (us):")
+    print(f"  {'segment':<20} {'count':>6} {'mean':>8} {'p50':>8} {'p99':>8} {'max':>8}")
+    for name, values in errors.items():
+        absolute = sorted(abs(value) for value in values)
+        p50 = absolute[len(absolute) // 2]
+        p99 = absolute[min(len(absolute) - 1, (len(absolute) * 99) // 100)]
+        print(
+            f"  {name:<20} {len(values):>6} {statistics.mean(values):>8.1f} {p50:>8.1f} {p99:>8.1f} {absolute[-1]:>8.1f}"
+        )
+
+    unknown = sum(1 for level, duration in pulses if classify(level, duration)[1] is None)
+    if unknown:
+        print(f"  {unknown} pulses didn't match any segment")
+
+
+def report_frames(pulses, decoder):
+    print("Frames:")
+    count = 0
+    for frame, command, code, remote in decode_frames(pulses, decoder):
+        count += 1
+        name = COMMANDS.get(command, f"0x{command:X}")
+        print(f"  {frame}  remote {remote:06X} command {name} rolling code {code}")
+    if not count:
+        print("  none")
+
+
+def report_airtime(pulses):
+    total = sum(duration for _, duration in pulses)
+    high = sum(duration for level, duration in pulses if level)
+    print(f"Airtime: {total / 1000:.1f} ms total, {high / 1000:.1f} ms high, {len(pulses)} pulses")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Analyzes a captured Somfy RTS transmission.")
+    parser.add_argument("trace", help="edge trace CSV (time,level) or pulse list CSV (level,duration_us)")
+    parser.add_argument("--time-unit", choices=TIME_UNITS.keys(), default="s", help="unit of the time column")
+    parser.add_argument("--channel", type=int, default=1, help="column of the channel to analyze")
+    parser.add_argument(
+        "--decoder",
+        default=os.environ.get("SOMFY_DECODE", DEFAULT_DECODER),
+        help="path to the somfy-decode host tool, default $SOMFY_DECODE or the one in build-host",
+    )
+    args = parser.parse_args()
+
+    pulses = read_pulses(args.trace, args.time_unit, args.channel)
+    if not pulses:
+        print("No pulses in trace", file=sys.stderr)
+        sys.exit(1)
+
+    report_timing(pulses)
+    report_frames(pulses, args.decoder)
+    report_airtime(pulses)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+// Allocations made with the global operator new so far. Programs that use this link AllocationCounter.cpp, which
+// replaces operator new to count them.
+size_t get_allocation_count();
+
+// Reports the allocations made since before as allocs/op, averaged over the iterations.
+inline void report_allocations(benchmark::State& state, size_t before) {
+    state.counters["allocs/op"] =
+        benchmark::Counter(double(get_allocation_count() - before), benchmark::Counter::kAvgIterations);
+}
@@ -0,0 +1,167 @@
+#include "support.h"
+
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+#include "DeviceConfiguration.h"
+#include "MQTTConnection.h"
+
+// The device counts the benchmarks scale over, up to what a large installation has.
+static void device_counts(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgName("devices")->Arg(1)->Arg(8)->Arg(32);
+}
+
+// cJSON allocates with malloc. Handing its allocations to operator new counts them in allocs/op as well.
+[[maybe_unused]] static const bool cjson_allocations_counted = [] {
+    cJSON_Hooks hooks = {
+        [](size_t size) { return ::operator new(size); },
+        [](void* pointer) { ::operator delete(pointer); },
+    };
+    cJSON_InitHooks(&hooks);
+    return true;
+}();
+
+static const char* const COMMAND_NAMES[] = {"my",      "up",   "my_up",    "down", "my_down",
+                                            "up_down", "prog", "sun_flag", "flag"};
+
+// A configuration as the configuration endpoint serves it.
+static string get_configuration_json(int devices) {
+    string json = R"({"deviceName":"Somfy Remote","deviceEntityId":"somfy_remote",)"
+                  R"("mqtt":{"endpoint":"mqtt://localhost"},"devices":[)";
+    for (int i = 0; i < devices; i++) {
+        if (i) {
+            json += ",";
+        }
+        json += strformat(R"({"id":"blind%d","short_id":"blind%d","name":"Blind %d","radio":%d})", i, i, i, i % 2);
+    }
+    return json + "]}";
+}
+
+// A device with the given number of remotes, connected to the fake MQTT client. Like the application, it runs what
+// the connection queues after every event.
+class ConnectedDevice {
+    Queue _queue;
+    DeviceConfiguration _configuration;
+    MQTTConnection _connection{&_queue};
+
+public:
+    string topic_prefix;
+    int64_t commands{};
+    int64_t identifies{};
+
+    explicit ConnectedDevice(int devices) {
+        fakeMqtt.reset();
+        ESP_ERROR_CHECK(_configuration.parse(get_configuration_json(devices)));
+
+        _connection.set_configuration(&_configuration);
+        _connection.on_remote_command_requested([this](MQTTRemoteCommand) { commands++; });
+        _connection.on_identify_requested([this]() { identifies++; });
+        _connection.begin();
+        connect();
+
+        // The connection subscribes to everything below <prefix>set/.
+        topic_prefix = fakeMqtt.subscription.substr(0, fakeMqtt.subscription.length() - strlen("set/#"));
+    }
+
+    void connect() {
+        fakeMqtt.dispatch(MQTT_EVENT_CONNECTED);
+        _queue.process();
+    }
+
+    void receive(string_view topic, string_view data = {}) {
+        fakeMqtt.dispatch(MQTT_EVENT_DATA, topic, data);
+        _queue.process();
+    }
+};
+
+static void BM_ParseConfiguration(benchmark::State& state) {
+    const auto json = get_configuration_json(state.range(0));
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        DeviceConfiguration configuration;
+        if (configuration.parse(json) != ESP_OK) {
+            state.SkipWithError("configuration didn't parse");
+            break;
+        }
+        benchmark::DoNotOptimize(configuration.get_devices().data());
+    }
+    report_allocations(state, allocations);
+    state.SetBytesProcessed(state.iterations() * json.length());
+}
+BENCHMARK(BM_ParseConfiguration)->Apply(device_counts);
+
+// A command for the last device, which find_remote_id finds after comparing all others. Routing works on views of the
+// topic, but handing the command to the main task allocates: the queue takes it as a std::function.
+static void BM_RouteCommand(benchmark::State& state) {
+    const auto devices = int(state.range(0));
+    ConnectedDevice device(devices);
+    const auto topic = device.topic_prefix + strformat("set/blind%d/down", devices - 1);
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        device.receive(topic);
+    }
+    report_allocations(state, allocations);
+
+    if (device.commands != state.iterations()) {
+        state.SkipWithError("command wasn't routed");
+    }
+}
+BENCHMARK(BM_RouteCommand)->Apply(device_counts);
+
+// command_id_from_name compares the names in order, so the later ones take longest.
+static void BM_RouteCommandName(benchmark::State& state) {
+    ConnectedDevice device(1);
+    const auto name = COMMAND_NAMES[state.range(0)];
+    const auto topic = device.topic_prefix + "set/blind0/" + name;
+    state.SetLabel(name);
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        device.receive(topic);
+    }
+    report_allocations(state, allocations);
+
+    if (device.commands != state.iterations()) {
+        state.SkipWithError("command wasn't routed");
+    }
+}
+BENCHMARK(BM_RouteCommandName)->DenseRange(0, size(COMMAND_NAMES) - 1);
+
+// A topic of the device itself, which is routed without looking up a remote.
+static void BM_RouteIdentify(benchmark::State& state) {
+    ConnectedDevice device(1);
+    const auto topic = device.topic_prefix + "set/identify";
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        device.receive(topic);
+    }
+    report_allocations(state, allocations);
+
+    if (device.identifies != state.iterations()) {
+        state.SkipWithError("identify wasn't routed");
+    }
+}
+BENCHMARK(BM_RouteIdentify);
+
+// Everything published on connecting: the configuration and the discovery messages of the device and its remotes.
+static void BM_PublishDiscovery(benchmark::State& state) {
+    ConnectedDevice device(state.range(0));
+    const auto published = fakeMqtt.published;
+    const auto published_bytes = fakeMqtt.published_bytes;
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        device.connect();
+    }
+    report_allocations(state, allocations);
+
+    state.counters["messages/op"] =
+        benchmark::Counter(fakeMqtt.published - published, benchmark::Counter::kAvgIterations);
+    state.SetBytesProcessed(int64_t(fakeMqtt.published_bytes - published_bytes));
+}
+BENCHMARK(BM_PublishDiscovery)->Apply(device_counts);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+#pragma once
+
+// Golden files hold the expected output of the code under test, stored in golden/. After an intended change, run
+// the tests with SOMFY_UPDATE_GOLDEN=1 to rewrite them, and review the difference.
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct GoldenPulse {
+    bool level;
+    uint32_t duration_us;
+
+    bool operator==(const GoldenPulse& other) const = default;
+};
+
+inline std::string get_golden_path(const std::string& name) { return std::string(GOLDEN_DIR) + "/" + name; }
+
+inline bool is_updating_golden() { return getenv("SOMFY_UPDATE_GOLDEN") != nullptr; }
+
+// Merges consecutive pulses with the same level, the way they show up on a logic analyzer.
+inline std::vector<GoldenPulse> merge_pulses(const std::vector<GoldenPulse>& pulses) {
+    std::vector<GoldenPulse> result;
+    for (const auto& pulse : pulses) {
+        if (!result.empty() && result.back().level == pulse.level) {
+            result.back().duration_us += pulse.duration_us;
+        } else {
+            result.push_back(pulse);
+        }
+    }
+    return result;
+}
+
+// Pulse lists are stored as level,duration_us rows, the format scripts/analyze-trace.py reads. Lines starting with
+// a semicolon are comments.
+inline std::vector<GoldenPulse> read_golden_pulses(const std::string& name) {
+    std::ifstream file(get_golden_path(name));
+    EXPECT_TRUE(file.is_open()) << "Missing golden file " << name;
+
+    std::vector<GoldenPulse> result;
+    std::string line;
+    while (getline(file, line)) {
+        int level;
+        uint32_t duration_us;
+        if (sscanf(line.c_str(), "%d,%u", &level, &duration_us) == 2) {
+            result.push_back({level != 0, duration_us});
+        }
+    }
+    return result;
+}
+
+inline void write_golden_pulses(const std::string& name, const std::string& comment,
+                                const std::vector<GoldenPulse>& pulses) {
+    std::ofstream file(get_golden_path(name));
+    std::istringstream lines(comment);
+    std::string line;
+    while (getline(lines, line)) {
+        file << "; " << line << "\n";
+    }
+    file << "level,duration_us\n";
+    for (const auto& pulse : pulses) {
+        file << (pulse.level ? 1 : 0) << "," << pulse.duration_us << "\n";
+    }
+}
+
+// Compares the pulses against the golden file, after merging them.
+inline void expect_golden_pulses(const std::string& name, const std::string& comment,
+                                 const std::vector<GoldenPulse>& pulses) {
+    const auto merged = merge_pulses(pulses);
+
+    if (is_updating_golden()) {
+        write_golden_pulses(name, comment, merged);
+        return;
+    }
+
+    const auto expected = read_golden_pulses(name);
+    ASSERT_EQ(expected.size(), merged.size()) << name;
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i].level, merged[i].level) << name << " pulse " << i;
+        EXPECT_EQ(expected[i].duration_us, merged[i].duration_us) << name << " pulse " << i;
+    }
+}
+
+// Text golden files are compared line by line.
+inline void expect_golden_text(const std::string& name, const std::string& text) {
+    if (is_updating_golden()) {
+        std::ofstream(get_golden_path(name)) << text;
+        return;
+    }
+
+    std::ifstream file(get_golden_path(name));
+    ASSERT_TRUE(file.is_open()) << "Missing golden file " << name;
+    std::stringstream expected;
+    expected << file.rdbuf();
+    EXPECT_EQ(expected.str(), text) << name;
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include "NVSRollingCodeStorage.h"
+
+class NVSRollingCodeStorageTest : public testing::Test {
+protected:
+    void SetUp() override { fakeNvs.reset(); }
+};
+
+TEST_F(NVSRollingCodeStorageTest, BlockOfOneWritesEveryCode) {
+    NVSRollingCodeStorage storage("somfy", "remote");
+
+    for (uint16_t code = 1; code <= 10; code++) {
+        EXPECT_EQ(code, storage.nextCode());
+    }
+
+    EXPECT_EQ(10, fakeNvs.writes);
+    EXPECT_EQ(10, fakeNvs.commits);
+}
+
+TEST_F(NVSRollingCodeStorageTest, BlockWritesOncePerBlock) {
+    NVSRollingCodeStorage storage("somfy", "remote", 16);
+
+    for (uint16_t code = 1; code <= 160; code++) {
+        ASSERT_EQ(code, storage.nextCode());
+    }
+
+    // One write reserves every block of 16 codes, before its first code is handed out.
+    EXPECT_EQ(10, fakeNvs.writes);
+    // The handle stays open and the stored code is only read once.
+    EXPECT_EQ(1, fakeNvs.opens);
+    EXPECT_EQ(1, fakeNvs.reads);
+
+    // The next code starts a new block.
+    EXPECT_EQ(161, storage.nextCode());
+    EXPECT_EQ(11, fakeNvs.writes);
+}
+
+TEST_F(NVSRollingCodeStorageTest, RestartResumesAtReservedMark) {
+    {
+        NVSRollingCodeStorage storage("somfy", "remote", 16);
+        for (int i = 0; i < 5; i++) {
+            storage.nextCode();
+        }
+    }
+
+    // A restart skips the rest of the block, but never hands out a code twice.
+    NVSRollingCodeStorage storage("somfy", "remote", 16);
+    uint16_t code;
+    ASSERT_TRUE(storage.peekCode(code));
+    EXPECT_EQ(17, code);
+    EXPECT_EQ(17, storage.nextCode());
+}
+
+TEST_F(NVSRollingCodeStorageTest, RestartAfterEveryCode) {
+    // The worst case for skipping: every restart loses the rest of its block.
+    uint16_t previous = 0;
+    for (int restart = 0; restart < 10; restart++) {
+        NVSRollingCodeStorage storage("somfy", "remote", 16);
+        const auto code = storage.nextCode();
+        EXPECT_GT(code, previous);
+        EXPECT_LE(code - previous, 16);
+        previous = code;
+    }
+}
+
+TEST_F(NVSRollingCodeStorageTest, ReserveCodesGrowsTheBlock) {
+    NVSRollingCodeStorage storage("somfy", "remote", 4);
+
+    EXPECT_EQ(1, storage.reserveCodes(10));
+    EXPECT_EQ(11, storage.nextCode());
+
+    // Restarting resumes after all reserved codes.
+    NVSRollingCodeStorage restarted("somfy", "remote", 4);
+    EXPECT_GE(restarted.nextCode(), 12);
+}
+
+TEST_F(NVSRollingCodeStorageTest, SharedHandleIsNotClosed) {
+    nvs_handle_t handle;
+    ASSERT_EQ(ESP_OK, nvs_open("somfy", NVS_READWRITE, &handle));
+
+    {
+        NVSRollingCodeStorage first(handle, "first", 8);
+        NVSRollingCodeStorage second(handle, "second", 8);
+        EXPECT_EQ(1, first.nextCode());
+        EXPECT_EQ(1, second.nextCode());
+        EXPECT_EQ(2, first.nextCode());
+    }
+
+    EXPECT_EQ(1, fakeNvs.opens);
+    EXPECT_EQ(0, fakeNvs.closes);
+    EXPECT_EQ(2, fakeNvs.writes);
+}
+
+TEST_F(NVSRollingCodeStorageTest, MissingCodeStartsAtOne) {
+    NVSRollingCodeStorage storage("somfy", "remote", 16);
+
+    uint16_t code;
+    ASSERT_TRUE(storage.peekCode(code));
+    EXPECT_EQ(1, code);
+    EXPECT_EQ(1, storage.nextCode());
+}
+
+// Any other error must not start over at 1, which would overwrite the stored code with one the motor has seen.
+TEST_F(NVSRollingCodeStorageTest, ReadErrorRefusesCodes) {
+    {
+        NVSRollingCodeStorage storage("somfy", "remote", 16);
+        storage.reserveCodes(100);
+    }
+    const auto stored = fakeNvs.entries["somfy/remote"];
+    fakeNvs.read_errors["somfy/remote"] = ESP_FAIL;
+
+    NVSRollingCodeStorage storage("somfy", "remote", 16);
+    uint16_t code;
+    EXPECT_FALSE(storage.peekCode(code));
+    EXPECT_FALSE(storage.tryReserveCodes(1, code));
+    EXPECT_EQ(stored, fakeNvs.entries["somfy/remote"]);
+
+    // Once the code can be read again, the storage continues after it.
+    fakeNvs.read_errors.clear();
+    ASSERT_TRUE(storage.tryReserveCodes(1, code));
+    EXPECT_EQ(101, code);
+}
+
+TEST_F(NVSRollingCodeStorageTest, OpenErrorRefusesCodes) {
+    fakeNvs.open_errors["somfy"] = ESP_FAIL;
+
+    NVSRollingCodeStorage storage("somfy", "remote", 16);
+    uint16_t code;
+    EXPECT_FALSE(storage.peekCode(code));
+    EXPECT_FALSE(storage.tryReserveCodes(1, code));
+    EXPECT_EQ(0, fakeNvs.writes);
+}
+
+// Codes of a block that couldn't be stored would be handed out again after a restart.
+TEST_F(NVSRollingCodeStorageTest, WriteErrorRefusesCodes) {
+    NVSRollingCodeStorage storage("somfy", "remote", 4);
+    for (uint16_t expected = 1; expected <= 4; expected++) {
+        ASSERT_EQ(expected, storage.nextCode());
+    }
+
+    fakeNvs.write_errors["somfy/remote"] = ESP_FAIL;
+    uint16_t code;
+    EXPECT_FALSE(storage.tryReserveCodes(1, code));
+
+    fakeNvs.write_errors.clear();
+    ASSERT_TRUE(storage.tryReserveCodes(1, code));
+    EXPECT_EQ(5, code);
+
+    NVSRollingCodeStorage restarted("somfy", "remote", 4);
+    EXPECT_GT(restarted.nextCode(), 5);
+}
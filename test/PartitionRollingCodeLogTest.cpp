@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <numeric>
+#include <random>
+
+#include "PartitionRollingCodeStorage.h"
+
+using namespace std;
+
+// Small sectors keep the runs that fill them short; a sector must still hold a snapshot of the maximum number of
+// remotes.
+static constexpr size_t SECTORS = 3;
+static constexpr size_t SECTOR_SIZE = 1024;
+static constexpr size_t SLOTS_PER_SECTOR = SECTOR_SIZE / 8;
+static constexpr uint32_t REMOTES[] = {0x100001, 0x100002, 0x100003};
+
+// The codes every remote must at least get back after a restart: the code stored by the last advance that completed
+// before the power went. Codes handed out by that advance may have been sent, and can never be sent again.
+using Durable = map<uint32_t, uint16_t>;
+
+static void check_recovered(const PartitionRollingCodeLog& log, const Durable& durable, const string& context) {
+    for (const auto remote : REMOTES) {
+        const auto it = durable.find(remote);
+        const uint16_t minimum = it == durable.end() ? 1 : it->second;
+
+        // An advance torn by the power loss may or may not have made it.
+        const auto code = log.get(remote);
+        EXPECT_GE(code, minimum) << context << ": remote " << hex << remote;
+        EXPECT_LE(code, minimum + 1) << context << ": remote " << hex << remote;
+    }
+}
+
+// Advances the remotes round-robin until the power is cut or count codes are handed out.
+static void advance_codes(PartitionRollingCodeLog& log, Durable& durable, size_t count) {
+    for (size_t i = 0; i < count && fakeFlash.powered; i++) {
+        const auto remote = REMOTES[i % size(REMOTES)];
+        uint16_t code;
+        if (log.advance(remote, 1, code) && fakeFlash.powered) {
+            durable[remote] = code + 1;
+        }
+    }
+}
+
+class PartitionRollingCodeLogTest : public testing::Test {
+protected:
+    void SetUp() override { fakeFlash.format("codes", SECTORS, SECTOR_SIZE); }
+};
+
+TEST_F(PartitionRollingCodeLogTest, MissingPartition) {
+    PartitionRollingCodeLog log("other");
+    EXPECT_FALSE(log.begin());
+}
+
+TEST_F(PartitionRollingCodeLogTest, PartitionTooSmall) {
+    fakeFlash.format("codes", 1, SECTOR_SIZE);
+
+    PartitionRollingCodeLog log("codes");
+    EXPECT_FALSE(log.begin());
+}
+
+TEST_F(PartitionRollingCodeLogTest, RestartRecoversCodes) {
+    {
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin());
+        EXPECT_FALSE(log.contains(REMOTES[0]));
+        EXPECT_EQ(1, log.get(REMOTES[0]));
+
+        EXPECT_TRUE(log.put(REMOTES[0], 10));
+        EXPECT_TRUE(log.put(REMOTES[1], 20));
+        EXPECT_TRUE(log.put(REMOTES[0], 11));
+        uint16_t code;
+        EXPECT_TRUE(log.advance(REMOTES[0], 5, code));
+        EXPECT_EQ(11, code);
+    }
+
+    PartitionRollingCodeLog log("codes");
+    ASSERT_TRUE(log.begin());
+    EXPECT_TRUE(log.contains(REMOTES[0]));
+    EXPECT_EQ(16, log.get(REMOTES[0]));
+    EXPECT_EQ(20, log.get(REMOTES[1]));
+    EXPECT_FALSE(log.contains(REMOTES[2]));
+}
+
+static uint32_t get_many_remote(size_t index) { return 0x200000 + index; }
+
+TEST_F(PartitionRollingCodeLogTest, FullLogRefusesNewRemotes) {
+    PartitionRollingCodeLog log("codes");
+    ASSERT_TRUE(log.begin());
+    for (size_t i = 0; i < PartitionRollingCodeLog::MAX_REMOTES; i++) {
+        ASSERT_TRUE(log.put(get_many_remote(i), 100 + i));
+    }
+
+    const auto extra = get_many_remote(PartitionRollingCodeLog::MAX_REMOTES);
+    uint16_t code;
+    EXPECT_FALSE(log.put(extra, 10));
+    EXPECT_FALSE(log.advance(extra, 1, code));
+    EXPECT_FALSE(log.contains(extra));
+
+    // The remotes that made it keep working.
+    EXPECT_TRUE(log.advance(get_many_remote(0), 1, code));
+    EXPECT_EQ(100, code);
+}
+
+TEST_F(PartitionRollingCodeLogTest, DroppedRemotesMakeRoom) {
+    const auto max = PartitionRollingCodeLog::MAX_REMOTES;
+    const auto extra = get_many_remote(max);
+    {
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin());
+        for (size_t i = 0; i < max; i++) {
+            ASSERT_TRUE(log.put(get_many_remote(i), 100 + i));
+        }
+
+        // Keep the even remotes, and an odd one that's used again before the next sector starts.
+        vector<uint32_t> kept;
+        for (size_t i = 0; i < max; i += 2) {
+            kept.push_back(get_many_remote(i));
+        }
+        log.retain(kept.data(), kept.size());
+        uint16_t code;
+        ASSERT_TRUE(log.advance(get_many_remote(1), 1, code));
+        EXPECT_EQ(101, code);
+
+        // The dropped remotes stay until a new remote needs their entries.
+        EXPECT_TRUE(log.contains(get_many_remote(3)));
+        const auto erases = accumulate(fakeFlash.erases.begin(), fakeFlash.erases.end(), 0);
+        EXPECT_TRUE(log.put(extra, 10));
+        EXPECT_EQ(erases + 1, accumulate(fakeFlash.erases.begin(), fakeFlash.erases.end(), 0));
+        EXPECT_FALSE(log.contains(get_many_remote(3)));
+    }
+
+    // The older sectors still hold the dropped remotes, which must not come back.
+    PartitionRollingCodeLog log("codes");
+    ASSERT_TRUE(log.begin());
+    EXPECT_EQ(10, log.get(extra));
+    EXPECT_EQ(102, log.get(get_many_remote(1)));
+    for (size_t i = 0; i < max; i += 2) {
+        EXPECT_EQ(100 + i, log.get(get_many_remote(i))) << i;
+    }
+    for (size_t i = 3; i < max; i += 2) {
+        EXPECT_FALSE(log.contains(get_many_remote(i))) << i;
+    }
+
+    // All the freed entries can be used.
+    for (size_t i = max + 1; i < max + max / 2 - 1; i++) {
+        EXPECT_TRUE(log.put(get_many_remote(i), 1)) << i;
+    }
+    EXPECT_FALSE(log.put(get_many_remote(2 * max), 1));
+}
+
+TEST_F(PartitionRollingCodeLogTest, SpreadsErasesOverSectors) {
+    Durable durable;
+    {
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin());
+        advance_codes(log, durable, 10 * SLOTS_PER_SECTOR);
+    }
+
+    const auto [least, most] = minmax_element(fakeFlash.erases.begin(), fakeFlash.erases.end());
+    EXPECT_GE(*least, 3);
+    EXPECT_LE(*most - *least, 1);
+
+    PartitionRollingCodeLog log("codes");
+    ASSERT_TRUE(log.begin());
+    for (const auto remote : REMOTES) {
+        EXPECT_EQ(durable[remote], log.get(remote));
+    }
+}
+
+// Cuts the power at every byte of a run that starts two sectors, and checks that every restart gets back all codes
+// that were handed out, and that the log keeps working after it.
+TEST_F(PartitionRollingCodeLogTest, PowerLossAtEveryByte) {
+    const size_t count = 2 * SLOTS_PER_SECTOR + 10;
+
+    {
+        Durable durable;
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin());
+        advance_codes(log, durable, count);
+    }
+    const auto total = fakeFlash.bytes;
+
+    for (int64_t cut = 0; cut < total; cut++) {
+        const auto context = "power cut after " + to_string(cut) + " bytes";
+        fakeFlash.format("codes", SECTORS, SECTOR_SIZE);
+
+        Durable durable;
+        fakeFlash.cut_power_after(cut);
+        {
+            PartitionRollingCodeLog log("codes");
+            log.begin();
+            advance_codes(log, durable, count);
+        }
+        ASSERT_FALSE(fakeFlash.powered) << context;
+        fakeFlash.restore_power();
+
+        {
+            PartitionRollingCodeLog log("codes");
+            ASSERT_TRUE(log.begin()) << context;
+            check_recovered(log, durable, context);
+            if (HasFailure()) {
+                return;
+            }
+
+            for (const auto remote : REMOTES) {
+                durable[remote] = log.get(remote);
+            }
+            advance_codes(log, durable, SLOTS_PER_SECTOR);
+        }
+
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin()) << context;
+        for (const auto remote : REMOTES) {
+            ASSERT_EQ(durable[remote], log.get(remote)) << context << ": remote " << hex << remote;
+        }
+    }
+}
+
+// A remote that isn't used for a while only lives on in the snapshots. Cutting the power while every snapshot is
+// written must not lose it once the sector holding its last complete copy comes up for erasing.
+TEST_F(PartitionRollingCodeLogTest, RepeatedPowerLossWhileStartingSectors) {
+    Durable durable;
+    {
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin());
+        advance_codes(log, durable, size(REMOTES));
+    }
+
+    for (size_t boot = 0; boot < 3 * SECTORS; boot++) {
+        const auto context = "boot " + to_string(boot);
+        fakeFlash.restore_power();
+
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin()) << context;
+        check_recovered(log, durable, context);
+        for (const auto remote : REMOTES) {
+            durable[remote] = log.get(remote);
+        }
+
+        // The header and half of the first snapshot record make it.
+        fakeFlash.cut_power_after_next_erase(12);
+        for (size_t i = 0; i < SECTORS * SLOTS_PER_SECTOR && fakeFlash.powered; i++) {
+            uint16_t code;
+            if (log.advance(REMOTES[0], 1, code) && fakeFlash.powered) {
+                durable[REMOTES[0]] = code + 1;
+            }
+        }
+        ASSERT_FALSE(fakeFlash.powered) << context;
+    }
+
+    fakeFlash.restore_power();
+    PartitionRollingCodeLog log("codes");
+    ASSERT_TRUE(log.begin());
+    check_recovered(log, durable, "last boot");
+}
+
+TEST_F(PartitionRollingCodeLogTest, RandomPowerLoss) {
+    // A fixed seed so a failure can be reproduced.
+    mt19937 random(0x5EC7);
+    uniform_int_distribution<int64_t> cut(0, SECTORS * SECTOR_SIZE);
+    uniform_int_distribution<size_t> remote(0, size(REMOTES) - 1);
+
+    Durable durable;
+    for (int boot = 0; boot < 100; boot++) {
+        const auto context = "boot " + to_string(boot);
+        fakeFlash.restore_power();
+
+        PartitionRollingCodeLog log("codes");
+        ASSERT_TRUE(log.begin()) << context;
+        check_recovered(log, durable, context);
+        for (const auto remote : REMOTES) {
+            durable[remote] = log.get(remote);
+        }
+
+        fakeFlash.cut_power_after(cut(random));
+        while (fakeFlash.powered) {
+            const auto chosen = REMOTES[remote(random)];
+            uint16_t code;
+            if (log.advance(chosen, 1, code) && fakeFlash.powered) {
+                durable[chosen] = code + 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Transmitter that records the pulse trains instead of sending them. Completes every transmission as soon as it is
+// flushed.
+
+#include <vector>
+
+#include "GoldenFile.h"
+#include "SomfyTransmitter.h"
+
+class RecordingTransmitter : public SomfyTransmitter {
+    DoneCallback _done_callback{};
+    void* _done_arg{};
+
+public:
+    std::vector<SomfyPulseTrain> trains;
+    int flushes = 0;
+    int completions = 0;
+
+    void setup() override {}
+    void transmit(const SomfyPulseTrain& train) override { trains.push_back(train); }
+    void flush() override {
+        flushes++;
+        if (_done_callback) {
+            completions++;
+            _done_callback(_done_arg);
+        }
+    }
+    void wait() override {}
+    void setDoneCallback(DoneCallback callback, void* arg) override {
+        _done_callback = callback;
+        _done_arg = arg;
+    }
+
+    std::vector<GoldenPulse> get_pulses() const {
+        std::vector<GoldenPulse> result;
+        for (const auto& train : trains) {
+            for (size_t i = 0; i < train.size(); i++) {
+                result.push_back({train[i].level != 0, train[i].duration});
+            }
+        }
+        return result;
+    }
+};
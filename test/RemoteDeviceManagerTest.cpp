@@ -0,0 +1,490 @@
+#include "ELECHOUSE_CC1101_SRC_DRV.h"
+#include "RMTSomfyTransmitter.h"
+#include "SomfyRemote.h"
+
+// Comment to ensure that the library headers stay above support.h, like in the firmware.
+
+#include "support.h"
+
+#include <gtest/gtest.h>
+
+#include "RemoteDeviceManager.h"
+#include "nvs.h"
+
+static constexpr int DEVICE_COUNT = 6;
+static constexpr uint32_t FIRST_REMOTE = 0x5A0000;
+
+static string get_device_id(int device) { return "blind" + to_string(device); }
+
+// The remotes of the devices are taken over from the keys of older firmware, so every device has a known remote.
+// This has to happen before the first device is created, which loads the remote table for the whole process.
+static void store_remotes() {
+    nvs_handle_t handle;
+    ASSERT_EQ(ESP_OK, nvs_open("somfy_remotes", NVS_READWRITE, &handle));
+    for (int device = 0; device < DEVICE_COUNT; device++) {
+        ASSERT_EQ(ESP_OK, nvs_set_u32(handle, (get_device_id(device) + "_id").c_str(), FIRST_REMOTE + device));
+    }
+    nvs_close(handle);
+}
+
+static const char* get_command_name(Command command) {
+    switch (command) {
+        case Command::My:
+            return "my";
+        case Command::Up:
+            return "up";
+        case Command::Down:
+            return "down";
+        case Command::Prog:
+            return "prog";
+        default:
+            return "other";
+    }
+}
+
+struct Press {
+    int device;
+    Command command;
+    uint16_t code;
+    // Virtual time at which the first frame of the press ended.
+    uint64_t time_us;
+};
+
+// The presses a radio sent, in order. A press is sent as several frames with the same rolling code, which may be
+// interleaved with the frames of other remotes in a session.
+static vector<Press> get_presses(RMTSomfyTransmitter* radio) {
+    vector<Press> presses;
+    for (const auto& frame : radio->get_frames()) {
+        const auto device = int(frame.contents.remote - FIRST_REMOTE);
+        const auto seen = any_of(presses.begin(), presses.end(), [&](const Press& press) {
+            return press.device == device && press.code == frame.contents.code;
+        });
+        if (!seen) {
+            presses.push_back({device, frame.contents.command, frame.contents.code, frame.time_us});
+        }
+    }
+    return presses;
+}
+
+static vector<string> describe(const vector<Press>& presses) {
+    vector<string> result;
+    for (const auto& press : presses) {
+        result.push_back(get_device_id(press.device) + " " + get_command_name(press.command));
+    }
+    return result;
+}
+
+// For presses that share a session, where the order of the frames is up to the scheduler.
+static vector<string> describe_sorted(const vector<Press>& presses) {
+    auto result = describe(presses);
+    sort(result.begin(), result.end());
+    return result;
+}
+
+static size_t count_frames(RMTSomfyTransmitter* radio, int device) {
+    const auto frames = radio->get_frames();
+    return count_if(frames.begin(), frames.end(), [&](const RMTSomfyTransmitter::SentFrame& frame) {
+        return frame.contents.remote == FIRST_REMOTE + device;
+    });
+}
+
+static uint32_t get_press_airtime_ms() { return SomfyRemote::getCommandDuration() / 1000; }
+
+// Virtual time at which the last frame a radio sent for the device ended, in milliseconds.
+static uint64_t get_finish_ms(RMTSomfyTransmitter* radio, int device) {
+    uint64_t finish_us = 0;
+    for (const auto& frame : radio->get_frames()) {
+        if (frame.contents.remote == FIRST_REMOTE + device) {
+            finish_us = frame.time_us;
+        }
+    }
+    return finish_us / 1000;
+}
+
+class RemoteDeviceManagerTest : public testing::Test {
+protected:
+    // Like in the firmware, the manager and its radio tasks are never destroyed. They're idle once a test is done.
+    RemoteDeviceManager* manager{};
+    vector<RMTSomfyTransmitter*> radios;
+    mutex statistics_lock;
+    CommandQueueStatistics statistics{};
+
+    static void SetUpTestSuite() { store_remotes(); }
+
+    // Starts a manager for the first count devices, spread over the radios in order unless assigned to one.
+    void start(int count, const vector<int>& assigned_radios = {}) {
+        ELECHOUSE_cc1101.reset();
+        manager = new RemoteDeviceManager();
+        ASSERT_EQ(ESP_OK, manager->begin());
+        radios.assign(RMTSomfyTransmitter::instances.end() - CONFIG_DEVICE_RADIO_COUNT,
+                      RMTSomfyTransmitter::instances.end());
+
+        manager->on_queue_statistics_changed([this](const CommandQueueStatistics& changed) {
+            // Reported by the tasks and the callers, so an older snapshot may arrive last. The counters only grow.
+            lock_guard<mutex> lock(statistics_lock);
+            if (get_total(changed) >= get_total(statistics)) {
+                statistics = changed;
+            }
+        });
+
+        vector<RemoteDeviceConfiguration> devices;
+        for (int device = 0; device < count; device++) {
+            const auto radio = device < assigned_radios.size() ? assigned_radios[device] : -1;
+            devices.push_back({get_device_id(device), get_device_id(device), get_device_id(device), radio});
+        }
+        manager->set_devices(devices);
+
+        ASSERT_TRUE(host_wait_until_idle());
+    }
+
+    void TearDown() override {
+        for (const auto radio : radios) {
+            radio->release();
+        }
+        EXPECT_TRUE(host_wait_until_idle());
+    }
+
+    bool press(int device, RemoteCommandId command_id) {
+        return manager->queue_command(device, command_id, false, esp_get_millis(), 0);
+    }
+
+    bool long_press(int device, RemoteCommandId command_id, uint32_t deadline_ms = 0) {
+        return manager->queue_command(device, command_id, true, esp_get_millis(), deadline_ms);
+    }
+
+    // Keeps a radio busy with a press for the device, so the commands queued after it wait.
+    void occupy(int radio, int device) {
+        radios[radio]->hold();
+        ASSERT_TRUE(press(device, RemoteCommandId::Up));
+        ASSERT_TRUE(radios[radio]->wait_until_blocked());
+    }
+
+    void release_all() {
+        for (const auto radio : radios) {
+            radio->release();
+        }
+        ASSERT_TRUE(host_wait_until_idle());
+    }
+
+    CommandQueueStatistics get_statistics() {
+        lock_guard<mutex> lock(statistics_lock);
+        return statistics;
+    }
+
+private:
+    static uint64_t get_total(const CommandQueueStatistics& statistics) {
+        return uint64_t(statistics.sent) + statistics.expired + statistics.superseded + statistics.duplicates;
+    }
+};
+
+TEST_F(RemoteDeviceManagerTest, BurstSendsLatestDirection) {
+    start(2, {0, 0});
+    occupy(0, 0);
+
+    // An automation firing while the radio is busy.
+    ASSERT_TRUE(press(1, RemoteCommandId::Up));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(1, RemoteCommandId::Up));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    release_all();
+
+    const auto presses = get_presses(radios[0]);
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 down"}), describe(presses));
+
+    const auto statistics = get_statistics();
+    EXPECT_EQ(3, statistics.superseded);
+    EXPECT_EQ(0, statistics.duplicates);
+    EXPECT_EQ(3 * get_press_airtime_ms(), statistics.airtime_saved_ms);
+    EXPECT_EQ(2, statistics.sent);
+
+    // The superseded presses never got a rolling code.
+    ASSERT_TRUE(press(1, RemoteCommandId::Up));
+    ASSERT_TRUE(host_wait_until_idle());
+
+    const auto next = get_presses(radios[0]);
+    ASSERT_EQ(3, next.size());
+    EXPECT_EQ(presses[1].code + 1, next[2].code);
+}
+
+TEST_F(RemoteDeviceManagerTest, DuplicatePressesAreDropped) {
+    start(2, {0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 down"}), describe(get_presses(radios[0])));
+
+    const auto statistics = get_statistics();
+    EXPECT_EQ(0, statistics.superseded);
+    EXPECT_EQ(2, statistics.duplicates);
+    EXPECT_EQ(2 * get_press_airtime_ms(), statistics.airtime_saved_ms);
+}
+
+TEST_F(RemoteDeviceManagerTest, StopSupersedesDirectionAndIsSentOnce) {
+    start(2, {0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(1, RemoteCommandId::My));
+    ASSERT_TRUE(press(1, RemoteCommandId::My));
+    ASSERT_TRUE(press(1, RemoteCommandId::My));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 my"}), describe(get_presses(radios[0])));
+
+    const auto statistics = get_statistics();
+    EXPECT_EQ(1, statistics.superseded);
+    EXPECT_EQ(2, statistics.duplicates);
+}
+
+TEST_F(RemoteDeviceManagerTest, DirectionAfterStopIsSent) {
+    start(2, {0, 0});
+    occupy(0, 0);
+
+    // The stop is queued ahead of everything else, but the down after it is the latest direction.
+    ASSERT_TRUE(press(1, RemoteCommandId::Up));
+    ASSERT_TRUE(press(1, RemoteCommandId::My));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 down"}), describe(get_presses(radios[0])));
+}
+
+TEST_F(RemoteDeviceManagerTest, PressesForDifferentDevicesAreAllSent) {
+    start(3, {0, 0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(2, RemoteCommandId::Down));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 down", "blind2 down"}), describe(get_presses(radios[0])));
+    EXPECT_EQ(0, get_statistics().superseded + get_statistics().duplicates);
+}
+
+TEST_F(RemoteDeviceManagerTest, RepeatedPressAfterSendingIsSent) {
+    start(1);
+
+    ASSERT_TRUE(press(0, RemoteCommandId::Up));
+    ASSERT_TRUE(host_wait_until_idle());
+    ASSERT_TRUE(press(0, RemoteCommandId::Up));
+    ASSERT_TRUE(host_wait_until_idle());
+
+    const auto presses = get_presses(radios[0]);
+    EXPECT_EQ(vector<string>({"blind0 up", "blind0 up"}), describe(presses));
+    EXPECT_EQ(0, get_statistics().duplicates);
+}
+
+TEST_F(RemoteDeviceManagerTest, ProgIsNeverCoalesced) {
+    start(2, {0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Prog));
+    ASSERT_TRUE(press(1, RemoteCommandId::Prog));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 prog", "blind1 prog"}), describe(get_presses(radios[0])));
+}
+
+TEST_F(RemoteDeviceManagerTest, FullQueueSendsLatestPressInPlaceOfQueuedOne) {
+    start(3, {0, 0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Up));
+    int progs = 0;
+    while (press(2, RemoteCommandId::Prog)) {
+        progs++;
+    }
+    ASSERT_GT(progs, 0);
+
+    // There's no room for the down, so the queued up is sent as the down.
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    release_all();
+
+    const auto presses = describe(get_presses(radios[0]));
+    EXPECT_EQ(1, count(presses.begin(), presses.end(), "blind1 down"));
+    EXPECT_EQ(0, count(presses.begin(), presses.end(), "blind1 up"));
+    EXPECT_EQ(progs, count(presses.begin(), presses.end(), "blind2 prog"));
+    EXPECT_EQ(1, get_statistics().superseded);
+}
+
+// A mixed workload on a busy radio: a long press is queued first, then short presses for other devices.
+TEST_F(RemoteDeviceManagerTest, ShortPressesOvertakeLongPress) {
+    start(5, {0, 0, 0, 0, 0});
+    const auto start_ms = esp_get_millis();
+    occupy(0, 0);
+
+    // A later deadline than the default, so the long press can wait for the session of short presses.
+    ASSERT_TRUE(long_press(1, RemoteCommandId::Up, 10000));
+    for (int device = 2; device < 5; device++) {
+        ASSERT_TRUE(press(device, RemoteCommandId::Down));
+    }
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind2 down", "blind3 down", "blind4 down", "blind1 up"}),
+              describe(get_presses(radios[0])));
+
+    const auto statistics = get_statistics();
+    ASSERT_EQ(5, statistics.sent);
+    EXPECT_EQ(0, statistics.expired);
+
+    // Every device reports its own wait. The short presses share a session.
+    ASSERT_EQ(5, statistics.devices.size());
+    for (int device = 0; device < 5; device++) {
+        EXPECT_EQ(1, statistics.devices[device].sent) << get_device_id(device);
+        EXPECT_EQ(statistics.devices[device].wait_total_ms, statistics.devices[device].wait_max_ms);
+    }
+    const auto short_wait_ms = statistics.devices[2].wait_max_ms;
+    EXPECT_EQ(short_wait_ms, statistics.devices[3].wait_max_ms);
+    EXPECT_EQ(short_wait_ms, statistics.devices[4].wait_max_ms);
+    EXPECT_GT(statistics.devices[1].wait_max_ms, short_wait_ms);
+
+    // The airtimes of the jobs in the order they were sent, from the frames on the air.
+    const auto first_ms = get_finish_ms(radios[0], 0) - start_ms;
+    const auto hold_ms = get_finish_ms(radios[0], 1) - get_finish_ms(radios[0], 4);
+    EXPECT_GE(hold_ms, RemoteDevice::get_long_press_ms(RemoteCommandId::Up));
+
+    // First come, first served would have sent the long press right after the first press, so the short presses
+    // would have waited for it.
+    const auto fifo_total_ms = first_ms + 3 * (first_ms + hold_ms);
+    const auto hrrn_total_ms = statistics.latency_total_ms;
+    RecordProperty("fifo_mean_latency_ms", int(fifo_total_ms / 5));
+    RecordProperty("hrrn_mean_latency_ms", int(hrrn_total_ms / 5));
+    EXPECT_LT(hrrn_total_ms, fifo_total_ms);
+}
+
+TEST_F(RemoteDeviceManagerTest, WaitingLongPressIsNotStarved) {
+    start(4, {0, 0, 0, 0});
+    occupy(0, 0);
+
+    // The ratio of the long press grows while it waits, until it's ahead of short presses queued later.
+    ASSERT_TRUE(long_press(1, RemoteCommandId::Up, 10000));
+    hostMicros += 2ull * RemoteDevice::get_long_press_ms(RemoteCommandId::Up) * 1000;
+    ASSERT_TRUE(press(2, RemoteCommandId::Down));
+    ASSERT_TRUE(press(3, RemoteCommandId::Down));
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 up", "blind2 down", "blind3 down"}),
+              describe(get_presses(radios[0])));
+    EXPECT_EQ(4, get_statistics().sent);
+}
+
+TEST_F(RemoteDeviceManagerTest, CommandsPastDeadlineAreDropped) {
+    start(3, {0, 0, 0});
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(long_press(2, RemoteCommandId::Up));
+    hostMicros += (CONFIG_DEVICE_COMMAND_DEADLINE_MS + 1000) * 1000ull;
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up"}), describe(get_presses(radios[0])));
+
+    const auto statistics = get_statistics();
+    EXPECT_EQ(1, statistics.sent);
+    EXPECT_EQ(2, statistics.expired);
+    EXPECT_EQ(0, statistics.devices[1].sent);
+    EXPECT_EQ(0, statistics.devices[2].sent);
+
+    // The device is served again once it's within the deadline.
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(host_wait_until_idle());
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 down"}), describe(get_presses(radios[0])));
+}
+
+TEST_F(RemoteDeviceManagerTest, RadiosAreInitialized) {
+    start(1);
+
+    ASSERT_EQ(2, radios.size());
+    EXPECT_EQ(CONFIG_DEVICE_GDO0_PIN, radios[0]->get_pin());
+    EXPECT_EQ(CONFIG_DEVICE_RADIO1_GDO0_PIN, radios[1]->get_pin());
+
+    const auto first = ELECHOUSE_cc1101.get_module(0);
+    EXPECT_TRUE(first.initialized);
+    EXPECT_EQ(CONFIG_DEVICE_CSN_PIN, first.ss_pin);
+    EXPECT_EQ(CONFIG_DEVICE_GDO0_PIN, first.gdo0_pin);
+    EXPECT_FLOAT_EQ(433.42, first.mhz);
+
+    const auto second = ELECHOUSE_cc1101.get_module(1);
+    EXPECT_TRUE(second.initialized);
+    EXPECT_EQ(CONFIG_DEVICE_RADIO1_CSN_PIN, second.ss_pin);
+    EXPECT_EQ(CONFIG_DEVICE_RADIO1_GDO0_PIN, second.gdo0_pin);
+    EXPECT_FLOAT_EQ(433.42, second.mhz);
+}
+
+TEST_F(RemoteDeviceManagerTest, DevicesAreSpreadOverRadios) {
+    start(4);
+
+    for (int device = 0; device < 4; device++) {
+        ASSERT_TRUE(press(device, RemoteCommandId::Down));
+    }
+    ASSERT_TRUE(host_wait_until_idle());
+
+    EXPECT_EQ(vector<string>({"blind0 down", "blind2 down"}), describe_sorted(get_presses(radios[0])));
+    EXPECT_EQ(vector<string>({"blind1 down", "blind3 down"}), describe_sorted(get_presses(radios[1])));
+}
+
+TEST_F(RemoteDeviceManagerTest, DevicesAreSentOnAssignedRadio) {
+    // A radio that doesn't exist is treated as no radio.
+    start(4, {1, 1, 0, 5});
+
+    for (int device = 0; device < 4; device++) {
+        ASSERT_TRUE(press(device, RemoteCommandId::Up));
+    }
+    ASSERT_TRUE(host_wait_until_idle());
+
+    EXPECT_EQ(vector<string>({"blind2 up"}), describe(get_presses(radios[0])));
+    EXPECT_EQ(vector<string>({"blind0 up", "blind1 up", "blind3 up"}), describe_sorted(get_presses(radios[1])));
+}
+
+TEST_F(RemoteDeviceManagerTest, RadioKeepsSendingWhileOtherIsBusy) {
+    start(4);
+    occupy(0, 0);
+
+    ASSERT_TRUE(press(2, RemoteCommandId::Down));
+    ASSERT_TRUE(press(1, RemoteCommandId::Down));
+    ASSERT_TRUE(press(3, RemoteCommandId::Up));
+    ASSERT_TRUE(host_wait_until_idle());
+
+    // The second radio is done, and back to idle, while the first one is still transmitting.
+    EXPECT_EQ(vector<string>({"blind1 down", "blind3 up"}), describe_sorted(get_presses(radios[1])));
+    EXPECT_TRUE(get_presses(radios[0]).empty());
+    EXPECT_EQ(ELECHOUSE_CC1101::Mode::Tx, ELECHOUSE_cc1101.get_module(0).mode);
+    EXPECT_EQ(ELECHOUSE_CC1101::Mode::Idle, ELECHOUSE_cc1101.get_module(1).mode);
+
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind2 down"}), describe(get_presses(radios[0])));
+    EXPECT_EQ(ELECHOUSE_CC1101::Mode::Idle, ELECHOUSE_cc1101.get_module(0).mode);
+}
+
+TEST_F(RemoteDeviceManagerTest, StopPreemptsOnlyHoldOnItsRadio) {
+    start(3, {0, 1, 0});
+
+    radios[0]->hold();
+    radios[1]->hold();
+    ASSERT_TRUE(long_press(0, RemoteCommandId::Up));
+    ASSERT_TRUE(long_press(1, RemoteCommandId::Up));
+    ASSERT_TRUE(radios[0]->wait_until_blocked());
+    ASSERT_TRUE(radios[1]->wait_until_blocked());
+    const auto start_ms = esp_get_millis();
+
+    // The stop for the other device on the first radio ends its hold after the first frame.
+    ASSERT_TRUE(press(2, RemoteCommandId::My));
+    radios[0]->release();
+    ASSERT_TRUE(host_wait_until_idle());
+
+    EXPECT_EQ(vector<string>({"blind0 up", "blind2 my"}), describe(get_presses(radios[0])));
+    EXPECT_EQ(1, count_frames(radios[0], 0));
+    EXPECT_TRUE(get_presses(radios[1]).empty());
+
+    // The hold on the second radio runs for its full duration.
+    release_all();
+
+    EXPECT_EQ(vector<string>({"blind1 up"}), describe(get_presses(radios[1])));
+    EXPECT_GT(count_frames(radios[1], 1), 1);
+    EXPECT_GE(get_finish_ms(radios[1], 1) - start_ms, RemoteDevice::get_long_press_ms(RemoteCommandId::Up));
+}
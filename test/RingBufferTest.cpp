@@ -0,0 +1,140 @@
+#include "support.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "RemoteDeviceManager.h"
+#include "RingBuffer.h"
+
+// The queue between the task queueing commands and a radio task. Built with ThreadSanitizer, which reports a slot
+// that's read while it's written.
+
+static constexpr uint32_t COMMAND_COUNT = 2000000;
+static constexpr uint32_t DEPTH = 16;
+
+// Every field depends on the sequence, so a command that's torn by a concurrent write doesn't add up.
+static RemoteCommand make_command(uint32_t sequence) {
+    return {int(sequence % 7), RemoteCommandId::Up, sequence, sequence * 3, sequence * 5, sequence * 11};
+}
+
+static bool is_intact(const RemoteCommand& command) {
+    const auto sequence = command.sequence;
+    return command.device_id == int(sequence % 7) && command.command_id == RemoteCommandId::Up &&
+           command.hold_ms == sequence * 3 && command.received_ms == sequence * 5 &&
+           command.deadline_ms == sequence * 11;
+}
+
+// Takes commands until the producer is done and the queue is empty. The commands must come out in order.
+static vector<uint32_t> drain(RingBuffer<RemoteCommand>& commands, const atomic<bool>& done) {
+    vector<uint32_t> result;
+    RemoteCommand command;
+    while (true) {
+        const auto finished = done.load();
+        while (commands.pop(command)) {
+            EXPECT_TRUE(is_intact(command)) << command.sequence;
+            EXPECT_TRUE(result.empty() || command.sequence > result.back()) << command.sequence;
+            result.push_back(command.sequence);
+        }
+        if (finished) {
+            return result;
+        }
+        this_thread::yield();
+    }
+}
+
+TEST(RingBufferTest, QueuesInOrder) {
+    RingBuffer<RemoteCommand> commands(DEPTH);
+    EXPECT_EQ(DEPTH, commands.capacity());
+
+    for (uint32_t i = 0; i < DEPTH; i++) {
+        EXPECT_TRUE(commands.push(make_command(i)));
+    }
+    EXPECT_FALSE(commands.push(make_command(DEPTH)));
+    EXPECT_EQ(DEPTH, commands.size());
+    EXPECT_EQ(DEPTH, commands.high_water_mark());
+    EXPECT_EQ(1, commands.overflows());
+
+    RemoteCommand command;
+    for (uint32_t i = 0; i < DEPTH; i++) {
+        ASSERT_TRUE(commands.pop(command));
+        EXPECT_EQ(i, command.sequence);
+    }
+    EXPECT_FALSE(commands.pop(command));
+    EXPECT_TRUE(commands.empty());
+}
+
+TEST(RingBufferTest, EvictsOldest) {
+    RingBuffer<RemoteCommand> commands(DEPTH);
+
+    optional<RemoteCommand> evicted;
+    for (uint32_t i = 0; i < DEPTH; i++) {
+        EXPECT_TRUE(commands.push_evict(make_command(i), evicted));
+    }
+    EXPECT_FALSE(evicted.has_value());
+
+    EXPECT_TRUE(commands.push_evict(make_command(DEPTH), evicted));
+    ASSERT_TRUE(evicted.has_value());
+    EXPECT_EQ(0, evicted->sequence);
+    EXPECT_EQ(DEPTH, commands.size());
+
+    RemoteCommand command;
+    for (uint32_t i = 1; i <= DEPTH; i++) {
+        ASSERT_TRUE(commands.pop(command));
+        EXPECT_EQ(i, command.sequence);
+    }
+}
+
+// The producer retries until every command made it, so all come out.
+TEST(RingBufferTest, ConcurrentPushAndPop) {
+    RingBuffer<RemoteCommand> commands(DEPTH);
+    atomic<bool> done{false};
+
+    thread producer([&] {
+        for (uint32_t i = 0; i < COMMAND_COUNT; i++) {
+            while (!commands.push(make_command(i))) {
+                this_thread::yield();
+            }
+        }
+        done = true;
+    });
+    const auto taken = drain(commands, done);
+    producer.join();
+
+    EXPECT_EQ(COMMAND_COUNT, taken.size());
+}
+
+// The producer never waits, so it evicts while the consumer is taking commands. Every command must come out exactly
+// once, from either side.
+TEST(RingBufferTest, ConcurrentEvictAndPop) {
+    RingBuffer<RemoteCommand> commands(DEPTH);
+    atomic<bool> done{false};
+
+    vector<uint32_t> evicted_sequences;
+    uint32_t rejected = 0;
+    thread producer([&] {
+        for (uint32_t i = 0; i < COMMAND_COUNT; i++) {
+            optional<RemoteCommand> evicted;
+            if (!commands.push_evict(make_command(i), evicted)) {
+                rejected++;
+            }
+            if (evicted.has_value()) {
+                EXPECT_TRUE(is_intact(*evicted)) << evicted->sequence;
+                evicted_sequences.push_back(evicted->sequence);
+            }
+        }
+        done = true;
+    });
+    const auto taken = drain(commands, done);
+    producer.join();
+
+    vector<bool> seen(COMMAND_COUNT);
+    for (const auto& sequences : {taken, evicted_sequences}) {
+        for (const auto sequence : sequences) {
+            ASSERT_FALSE(seen[sequence]) << sequence;
+            seen[sequence] = true;
+        }
+    }
+    EXPECT_EQ(COMMAND_COUNT, taken.size() + evicted_sequences.size() + rejected);
+    EXPECT_EQ(evicted_sequences.size() + rejected, commands.overflows());
+}
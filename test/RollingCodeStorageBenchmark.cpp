@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+#include "NVSRollingCodeStorage.h"
+#include "nvs_flash.h"
+
+// nextCode as it was before the handle was kept open and codes were reserved in blocks: flash is initialized and
+// the namespace opened for every press, and every code is written and committed.
+static uint16_t next_code_per_press(const char* name, const char* key) {
+    ESP_ERROR_CHECK(nvs_flash_init());
+
+    nvs_handle_t handle;
+    ESP_ERROR_CHECK(nvs_open(name, NVS_READWRITE, &handle));
+
+    uint16_t code;
+    if (nvs_get_u16(handle, key, &code) != ESP_OK) {
+        code = 1;
+    }
+    nvs_set_u16(handle, key, code + 1);
+    nvs_commit(handle);
+
+    return code;
+}
+
+// The NVS stand-in keeps the entries in memory, so the time per press leaves out the flash itself. The accesses per
+// press show what the firmware saves on flash: writes/op and commits/op are the flash writes, and opens/op the
+// namespace lookups.
+static void report_nvs_accesses(benchmark::State& state) {
+    const auto per_press = [&](int count) { return benchmark::Counter(count, benchmark::Counter::kAvgIterations); };
+    state.counters["opens/op"] = per_press(fakeNvs.opens);
+    state.counters["writes/op"] = per_press(fakeNvs.writes);
+    state.counters["commits/op"] = per_press(fakeNvs.commits);
+}
+
+static void BM_NextCodePerPress(benchmark::State& state) {
+    fakeNvs.reset();
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(next_code_per_press("somfy", "remote"));
+    }
+    report_allocations(state, allocations);
+    report_nvs_accesses(state);
+}
+BENCHMARK(BM_NextCodePerPress);
+
+// With a block of one, every press still writes and commits, but on the handle that was kept open.
+static void BM_NextCodeReserved(benchmark::State& state) {
+    fakeNvs.reset();
+    NVSRollingCodeStorage storage("somfy", "remote", state.range(0));
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(storage.nextCode());
+    }
+    report_allocations(state, allocations);
+    report_nvs_accesses(state);
+}
+BENCHMARK(BM_NextCodeReserved)->ArgName("block")->Arg(1)->Arg(16)->Arg(32);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include "RecordingTransmitter.h"
+#include "SomfyChipEncoder.h"
+#include "SomfyRemote.h"
+
+using namespace std;
+
+static constexpr uint32_t REMOTE = 0x123456;
+static constexpr uint32_t CHIP_US = SomfyChipEncoder::CHIP_DURATION;
+
+static const Command COMMANDS[] = {
+    Command::My,     Command::Up,   Command::MyUp,    Command::Down, Command::MyDown,
+    Command::UpDown, Command::Prog, Command::SunFlag, Command::Flag,
+};
+
+// The first code, one with both bytes set and one that wraps around on the next command.
+static const uint16_t ROLLING_CODES[] = {1, 0x1234, 0xFFFF};
+
+// The trains of a command as the remote hands them to a transmitter.
+static vector<SomfyPulseTrain> render_transmission(Command command, uint16_t code, int repeat) {
+    RecordingTransmitter transmitter;
+    SomfyRemote remote(&transmitter, REMOTE, nullptr);
+    remote.sendCommandWithCode(command, code, repeat);
+    return transmitter.trains;
+}
+
+static vector<GoldenPulse> get_pulses(const vector<SomfyPulseTrain>& trains) {
+    vector<GoldenPulse> result;
+    for (const auto& train : trains) {
+        for (size_t i = 0; i < train.size(); i++) {
+            result.push_back({train[i].level != 0, train[i].duration});
+        }
+    }
+    return merge_pulses(result);
+}
+
+// Reads the chip stream the way the CC1101 transmitter fills its FIFO: the trains are queued up front and read in
+// FIFO sized chunks, padding the last byte.
+static vector<uint8_t> encode(const vector<SomfyPulseTrain>& trains) {
+    SomfyChipEncoder encoder;
+    for (const auto& train : trains) {
+        EXPECT_TRUE(encoder.push(train));
+    }
+
+    vector<uint8_t> chips;
+    uint8_t buffer[64];
+    while (const auto read = encoder.read(buffer, sizeof(buffer), true)) {
+        chips.insert(chips.end(), buffer, buffer + read);
+    }
+    EXPECT_TRUE(encoder.isEmpty());
+    return chips;
+}
+
+// Turns the chips, MSB first, back into the pulses the radio puts on the air.
+static vector<GoldenPulse> decode_chips(const vector<uint8_t>& chips) {
+    vector<GoldenPulse> result;
+    for (const auto chip_byte : chips) {
+        for (int i = 7; i >= 0; i--) {
+            const bool level = (chip_byte >> i) & 1;
+            if (!result.empty() && result.back().level == level) {
+                result.back().duration_us += CHIP_US;
+            } else {
+                result.push_back({level, CHIP_US});
+            }
+        }
+    }
+    return result;
+}
+
+static void expect_within_chip(const vector<GoldenPulse>& expected, const vector<GoldenPulse>& actual,
+                               const string& context) {
+    ASSERT_EQ(expected.size(), actual.size()) << context;
+
+    int64_t expected_time_us = 0;
+    int64_t actual_time_us = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(expected[i].level, actual[i].level) << context << " pulse " << i;
+
+        expected_time_us += expected[i].duration_us;
+        actual_time_us += actual[i].duration_us;
+
+        // The padding of the last byte extends the final silence.
+        if (i == expected.size() - 1) {
+            EXPECT_GE(actual[i].duration_us + CHIP_US, expected[i].duration_us) << context << " last pulse";
+            EXPECT_LT(actual[i].duration_us, expected[i].duration_us + 8 * CHIP_US) << context << " last pulse";
+            break;
+        }
+
+        EXPECT_LE(abs(int64_t(actual[i].duration_us) - int64_t(expected[i].duration_us)), CHIP_US)
+            << context << " pulse " << i;
+        // Every edge is on the chip boundary nearest to it, so the error doesn't accumulate.
+        EXPECT_LE(abs(actual_time_us - expected_time_us), CHIP_US / 2) << context << " edge after pulse " << i;
+    }
+}
+
+TEST(SomfyChipEncoderTest, ChipsMatchPulses) {
+    for (const auto command : COMMANDS) {
+        for (const auto code : ROLLING_CODES) {
+            for (const int repeat : {0, 1, 4}) {
+                const auto context = "command " + to_string(int(command)) + " code " + to_string(code) + " repeat " +
+                                     to_string(repeat);
+                const auto trains = render_transmission(command, code, repeat);
+
+                expect_within_chip(get_pulses(trains), decode_chips(encode(trains)), context);
+                if (HasFailure()) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// Trains queued while the stream is being read, in reads that don't line up with the trains, must give the same
+// chips as queueing them up front.
+TEST(SomfyChipEncoderTest, IncrementalReadsMatch) {
+    const auto trains = render_transmission(Command::Down, 0x1234, 4);
+    const auto expected = encode(trains);
+
+    SomfyChipEncoder encoder;
+    vector<uint8_t> chips;
+    uint8_t buffer[3];
+    for (const auto& train : trains) {
+        ASSERT_TRUE(encoder.push(train));
+        const auto read = encoder.read(buffer, sizeof(buffer), false);
+        chips.insert(chips.end(), buffer, buffer + read);
+    }
+    while (const auto read = encoder.read(buffer, sizeof(buffer), true)) {
+        chips.insert(chips.end(), buffer, buffer + read);
+    }
+
+    EXPECT_TRUE(encoder.isEmpty());
+    EXPECT_EQ(expected, chips);
+}
+
+TEST(SomfyChipEncoderTest, QueueFull) {
+    SomfyPulseTrain train;
+    train.append(HIGH, 640);
+    train.append(LOW, 640);
+
+    SomfyChipEncoder encoder;
+    for (size_t i = 0; i < SomfyChipEncoder::QUEUE_SIZE; i++) {
+        ASSERT_TRUE(encoder.push(train));
+    }
+    EXPECT_TRUE(encoder.isFull());
+    EXPECT_FALSE(encoder.push(train));
+
+    // Reading past a train makes room for the next one.
+    uint8_t buffer[5];
+    EXPECT_EQ(sizeof(buffer), encoder.read(buffer, sizeof(buffer), false));
+    EXPECT_FALSE(encoder.isFull());
+    EXPECT_TRUE(encoder.push(train));
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <cinttypes>
+#include <filesystem>
+
+#include "GoldenFile.h"
+#include "SomfyDecoder.h"
+
+using namespace std;
+
+static string format_frame(const SomfyFrame& frame) {
+    string result;
+    char hex[4];
+    for (uint8_t i = 0; i < SomfyFrame::SIZE; i++) {
+        snprintf(hex, sizeof(hex), i ? " %02X" : "%02X", frame[i]);
+        result += hex;
+    }
+    return result;
+}
+
+static vector<string> decode_pulses(const vector<GoldenPulse>& pulses) {
+    SomfyDecoder decoder;
+    vector<string> frames;
+    for (const auto& pulse : pulses) {
+        if (decoder.decode(pulse.level, pulse.duration_us)) {
+            frames.push_back(format_frame(decoder.getFrame()));
+        }
+    }
+    return frames;
+}
+
+struct EdgeRecording {
+    vector<GoldenPulse> pulses;
+    vector<string> expected;
+};
+
+// Edge recordings hold the edges as GPIOSomfyReceiver captures them: time_us,level rows with the time of the edge
+// and the level following it. "; expect <frame>" lines list the frames the recording must decode to, in order.
+static EdgeRecording read_edge_recording(const filesystem::path& path) {
+    ifstream file(path);
+    EXPECT_TRUE(file.is_open()) << "Missing recording " << path;
+
+    EdgeRecording result;
+    string line;
+    bool hasEdge = false;
+    uint64_t lastTime = 0;
+    bool lastLevel = false;
+    while (getline(file, line)) {
+        if (line.starts_with("; expect ")) {
+            result.expected.push_back(line.substr(9));
+            continue;
+        }
+
+        uint64_t time;
+        int level;
+        if (sscanf(line.c_str(), "%" SCNu64 ",%d", &time, &level) != 2) {
+            continue;
+        }
+
+        // An edge ends the pulse started by the previous one.
+        if (hasEdge) {
+            result.pulses.push_back({lastLevel, static_cast<uint32_t>(time - lastTime)});
+        }
+        hasEdge = true;
+        lastTime = time;
+        lastLevel = level != 0;
+    }
+    return result;
+}
+
+TEST(SomfyDecoderTest, EdgeRecordings) {
+    size_t recordings = 0;
+    for (const auto& entry : filesystem::directory_iterator(get_golden_path("edges"))) {
+        if (entry.path().extension() != ".csv") {
+            continue;
+        }
+        recordings++;
+
+        const auto recording = read_edge_recording(entry.path());
+        ASSERT_FALSE(recording.expected.empty()) << entry.path() << " doesn't expect any frames";
+        EXPECT_EQ(recording.expected, decode_pulses(recording.pulses)) << entry.path();
+    }
+    EXPECT_GT(recordings, 0u);
+}
+
+// Every transmission SomfyRemote sends must decode to its frame: once for the first frame and once per repeat.
+TEST(SomfyDecoderTest, GoldenTransmissions) {
+    ifstream frames(get_golden_path("frames.csv"));
+    ASSERT_TRUE(frames.is_open());
+
+    string line;
+    getline(frames, line);
+    while (getline(frames, line)) {
+        char command[16];
+        unsigned code, remote;
+        char frame[32];
+        if (sscanf(line.c_str(), "%15[^,],%u,%x,%31[^\n]", command, &code, &remote, frame) != 4 ||
+            remote != 0x123456) {
+            continue;
+        }
+
+        const auto name = string(command) + "_" + to_string(code) + ".csv";
+        EXPECT_EQ(vector<string>(2, frame), decode_pulses(read_golden_pulses(name))) << name;
+    }
+}
+
+TEST(SomfyDecoderTest, ContentsMatchFrame) {
+    const auto frame = SomfyFrame::build(Command::MyDown, 0xBEEF, 0xABCDEF);
+    vector<GoldenPulse> pulses = {{true, 2560}, {false, 2560}, {true, 2560}, {false, 2560}, {true, 4550}, {false, 640}};
+    for (uint8_t i = 0; i < SomfyFrame::SIZE; i++) {
+        for (int8_t j = 15; j >= 0; j--) {
+            pulses.push_back({((somfyManchester[frame[i]] >> j) & 1) != 0, 640});
+        }
+    }
+    pulses.push_back({false, 30000});
+
+    SomfyDecoder decoder;
+    bool decoded = false;
+    for (const auto& pulse : merge_pulses(pulses)) {
+        decoded |= decoder.decode(pulse.level, pulse.duration_us);
+    }
+
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(frame, decoder.getFrame());
+    EXPECT_EQ(Command::MyDown, decoder.getContents().command);
+    EXPECT_EQ(0xBEEF, decoder.getContents().code);
+    EXPECT_EQ(0xABCDEFu, decoder.getContents().remote);
+}
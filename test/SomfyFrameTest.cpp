@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "SomfyFrame.h"
+
+using namespace std;
+
+static const Command COMMANDS[] = {
+    Command::My,     Command::Up,   Command::MyUp,    Command::Down, Command::MyDown,
+    Command::UpDown, Command::Prog, Command::SunFlag, Command::Flag,
+};
+
+// Random requests covering every command, the full rolling code range and remotes with stray high bits, which the
+// frame must ignore.
+static vector<SomfyFrameContents> random_requests(size_t count, uint32_t seed) {
+    mt19937 random(seed);
+    uniform_int_distribution<size_t> command(0, size(COMMANDS) - 1);
+    uniform_int_distribution<uint32_t> code(0, 0xFFFF);
+    uniform_int_distribution<uint32_t> remote;
+
+    vector<SomfyFrameContents> requests;
+    for (size_t i = 0; i < count; i++) {
+        requests.push_back({COMMANDS[command(random)], static_cast<uint16_t>(code(random)), remote(random)});
+    }
+    return requests;
+}
+
+TEST(SomfyFrameTest, BatchMatchesScalar) {
+    // A fixed seed so a failure can be reproduced; the count covers batches of all small sizes below.
+    const auto requests = random_requests(10000, 0x50F7);
+
+    vector<SomfyFrame> frames(requests.size());
+    SomfyFrame::buildBatch(requests.data(), requests.size(), frames.data());
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto& request = requests[i];
+        const auto expected = SomfyFrame::build(request.command, request.code, request.remote);
+        ASSERT_EQ(expected, frames[i]) << "request " << i << ": command " << int(request.command) << " code "
+                                       << request.code << " remote " << request.remote;
+        EXPECT_EQ(expected.toWord(), SomfyFrame::encode(request.command, request.code, request.remote));
+    }
+}
+
+TEST(SomfyFrameTest, BatchSizes) {
+    const auto requests = random_requests(17, 1);
+
+    // Every batch size, so nothing depends on the batch being a multiple of some block size.
+    for (size_t count = 0; count <= requests.size(); count++) {
+        vector<SomfyFrame> frames(count + 1);
+        const SomfyFrame guard = {{0xDE, 0xAD, 0xBE, 0xEF, 0xDE, 0xAD, 0xBE}};
+        frames[count] = guard;
+
+        SomfyFrame::buildBatch(requests.data(), count, frames.data());
+
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_EQ(SomfyFrame::build(requests[i].command, requests[i].code, requests[i].remote), frames[i]);
+        }
+        EXPECT_EQ(guard, frames[count]) << "batch of " << count << " wrote past its end";
+    }
+}
+
+TEST(SomfyFrameTest, DecodeBatchRoundTrips) {
+    const auto requests = random_requests(1000, 2);
+
+    vector<SomfyFrame> frames(requests.size());
+    SomfyFrame::buildBatch(requests.data(), requests.size(), frames.data());
+
+    // Flip a bit of the last byte in every other frame. A flipped bit in any other byte changes two neighbouring
+    // bytes once the XOR chain is undone, which the nibble checksum can't see; the last byte has no successor.
+    mt19937 random(3);
+    for (size_t i = 1; i < frames.size(); i += 2) {
+        frames[i].data[SomfyFrame::SIZE - 1] ^= 1 << (random() % 8);
+    }
+
+    vector<SomfyFrameContents> contents(frames.size());
+    auto valid = make_unique<bool[]>(frames.size());
+    EXPECT_EQ(frames.size() / 2, SomfyFrame::decodeBatch(frames.data(), frames.size(), contents.data(), valid.get()));
+
+    for (size_t i = 0; i < frames.size(); i += 2) {
+        ASSERT_TRUE(valid[i]) << "frame " << i;
+        EXPECT_EQ(requests[i].command, contents[i].command);
+        EXPECT_EQ(requests[i].code, contents[i].code);
+        EXPECT_EQ(requests[i].remote & 0xFFFFFF, contents[i].remote);
+    }
+    for (size_t i = 1; i < frames.size(); i += 2) {
+        EXPECT_FALSE(valid[i]) << "frame " << i;
+    }
+}
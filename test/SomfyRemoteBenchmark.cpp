@@ -0,0 +1,159 @@
+#include <benchmark/benchmark.h>
+
+#include "AllocationCounter.h"
+#include "SomfyRemote.h"
+
+static constexpr uint32_t REMOTE = 0x123456;
+static constexpr uint16_t SYMBOL = 640;
+
+// Counts the pulses instead of sending them, so the benchmark measures the generation of the pulses only.
+class CountingOutput {
+public:
+    uint32_t pulses = 0;
+    uint32_t duration = 0;
+
+    void setup() {}
+    void high(uint16_t durationInMicroseconds) {
+        pulses++;
+        duration += durationInMicroseconds;
+    }
+    void low(uint16_t durationInMicroseconds) {
+        pulses++;
+        duration += durationInMicroseconds;
+    }
+    void pause(uint32_t durationInMilliseconds) { duration += durationInMilliseconds * 1000; }
+};
+
+// The data loop as it was before the Manchester table: shift and mask the frame for every bit.
+static void render_data_per_bit(const uint8_t* frame, SomfyPulseTrain& train) {
+    for (uint8_t i = 0; i < 56; i++) {
+        const bool bit = ((frame[i / 8] >> (7 - (i % 8))) & 1) == 1;
+        train.append(!bit, SYMBOL);
+        train.append(bit, SYMBOL);
+    }
+}
+
+static void render_data_table(const uint8_t* frame, SomfyPulseTrain& train) {
+    for (uint8_t i = 0; i < SomfyFrame::SIZE; i++) {
+        const uint16_t halfSymbols = somfyManchester[frame[i]];
+        for (int8_t j = 15; j >= 0; j--) {
+            train.append((halfSymbols >> j) & 1, SYMBOL);
+        }
+    }
+}
+
+static void send_data_per_bit(CountingOutput& output, const uint8_t* frame) {
+    for (uint8_t i = 0; i < 56; i++) {
+        if (((frame[i / 8] >> (7 - (i % 8))) & 1) == 1) {
+            output.low(SYMBOL);
+            output.high(SYMBOL);
+        } else {
+            output.high(SYMBOL);
+            output.low(SYMBOL);
+        }
+    }
+}
+
+static void send_data_table(CountingOutput& output, const uint8_t* frame) {
+    for (uint8_t i = 0; i < SomfyFrame::SIZE; i++) {
+        const uint16_t halfSymbols = somfyManchester[frame[i]];
+        for (int8_t j = 15; j >= 0; j--) {
+            if ((halfSymbols >> j) & 1) {
+                output.high(SYMBOL);
+            } else {
+                output.low(SYMBOL);
+            }
+        }
+    }
+}
+
+// Both paths must render the same pulses, otherwise comparing them is meaningless.
+static bool renders_match(const SomfyFrame& frame) {
+    SomfyPulseTrain perBit, table;
+    render_data_per_bit(frame.data, perBit);
+    render_data_table(frame.data, table);
+    if (perBit.size() != table.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < perBit.size(); i++) {
+        if (perBit[i].level != table[i].level || perBit[i].duration != table[i].duration) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <void (*Render)(const uint8_t*, SomfyPulseTrain&)>
+static void BM_RenderData(benchmark::State& state) {
+    const auto frame = SomfyFrame::build(Command::Up, 0x1234, REMOTE);
+    if (!renders_match(frame)) {
+        state.SkipWithError("per-bit and table renders differ");
+        return;
+    }
+
+    SomfyPulseTrain train;
+    for (auto _ : state) {
+        train.clear();
+        Render(frame.data, train);
+        benchmark::DoNotOptimize(train);
+    }
+    state.SetItemsProcessed(state.iterations() * 56);
+}
+BENCHMARK(BM_RenderData<render_data_per_bit>)->Name("RenderData/PerBit");
+BENCHMARK(BM_RenderData<render_data_table>)->Name("RenderData/Table");
+
+template <void (*Send)(CountingOutput&, const uint8_t*)>
+static void BM_SendData(benchmark::State& state) {
+    const auto frame = SomfyFrame::build(Command::Up, 0x1234, REMOTE);
+
+    CountingOutput output;
+    for (auto _ : state) {
+        Send(output, frame.data);
+        benchmark::DoNotOptimize(output);
+    }
+    state.SetItemsProcessed(state.iterations() * 56);
+}
+BENCHMARK(BM_SendData<send_data_per_bit>)->Name("SendData/PerBit");
+BENCHMARK(BM_SendData<send_data_table>)->Name("SendData/Table");
+
+// The complete frame body, as rendered for the RMT and CC1101 backends.
+static void BM_RenderFrameBody(benchmark::State& state) {
+    const auto frame = SomfyFrame::build(Command::Up, 0x1234, REMOTE);
+
+    SomfyPulseTrain train;
+    for (auto _ : state) {
+        SomfyRemote::renderFrameBody(frame.data, 7, train);
+        benchmark::DoNotOptimize(train);
+    }
+}
+BENCHMARK(BM_RenderFrameBody);
+
+// SomfyRemote::buildFrame copies this frame out for every command.
+static void BM_BuildFrame(benchmark::State& state) {
+    uint16_t code = 0;
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        auto frame = SomfyFrame::build(Command::Up, code++, REMOTE);
+        benchmark::DoNotOptimize(frame);
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_BuildFrame);
+
+// The names are compared in order, so the later ones take longest.
+static void BM_GetSomfyCommand(benchmark::State& state) {
+    static const char* const NAMES[] = {"My", "Up", "MyUp", "Down", "MyDown", "UpDown", "Prog", "SunFlag", "Flag", "8"};
+    const String name = NAMES[state.range(0)];
+    state.SetLabel(name.c_str());
+
+    const auto allocations = get_allocation_count();
+    for (auto _ : state) {
+        auto command = getSomfyCommand(name);
+        benchmark::DoNotOptimize(command);
+    }
+    report_allocations(state, allocations);
+}
+BENCHMARK(BM_GetSomfyCommand)->DenseRange(0, 9);
+
+BENCHMARK_MAIN();
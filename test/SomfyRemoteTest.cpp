@@ -0,0 +1,325 @@
+#include <gtest/gtest.h>
+
+#include "GoldenFile.h"
+#include "RecordingTransmitter.h"
+#include "SomfyRemote.h"
+#include "SomfySession.h"
+
+using namespace std;
+
+static constexpr uint32_t REMOTE = 0x123456;
+
+struct NamedCommand {
+    Command command;
+    const char* name;
+};
+
+static const NamedCommand COMMANDS[] = {
+    {Command::My, "my"},         {Command::Up, "up"},         {Command::MyUp, "my_up"},
+    {Command::Down, "down"},     {Command::MyDown, "my_down"}, {Command::UpDown, "up_down"},
+    {Command::Prog, "prog"},     {Command::SunFlag, "sun_flag"}, {Command::Flag, "flag"},
+};
+
+// The first code, one with both bytes set and one that wraps around on the next command.
+static const uint16_t ROLLING_CODES[] = {1, 0x1234, 0xFFFF};
+
+static string format_frame(const SomfyFrame& frame) {
+    string result;
+    char hex[4];
+    for (uint8_t i = 0; i < SomfyFrame::SIZE; i++) {
+        snprintf(hex, sizeof(hex), i ? " %02X" : "%02X", frame[i]);
+        result += hex;
+    }
+    return result;
+}
+
+static vector<GoldenPulse> to_golden(const SomfyRecorderOutput& output) {
+    vector<GoldenPulse> result;
+    for (const auto& pulse : output.pulses) {
+        result.push_back({pulse.level, pulse.durationInMicroseconds});
+    }
+    return result;
+}
+
+// The pulses SomfyRemote sends by toggling a pin: the first frame with two hardware syncs and the given number of
+// repeats with seven.
+static vector<GoldenPulse> record_transmission(const SomfyFrame& frame, int repeat) {
+    SomfyRecorderOutput output;
+    SomfyRemote::sendFrame(output, frame.data, 2);
+    for (int i = 0; i < repeat; i++) {
+        SomfyRemote::sendFrame(output, frame.data, 7);
+    }
+    return to_golden(output);
+}
+
+static string get_transmission_name(const NamedCommand& command, uint16_t code) {
+    return string(command.name) + "_" + to_string(code) + ".csv";
+}
+
+TEST(SomfyRemoteTest, FramesMatchGolden) {
+    string text = "command,code,remote,frame\n";
+
+    for (const auto remote : {REMOTE, 0xABCDEFu, 0x000001u}) {
+        for (const auto& command : COMMANDS) {
+            for (const auto code : ROLLING_CODES) {
+                char row[80];
+                snprintf(row, sizeof(row), "%s,%u,%06X,%s\n", command.name, code, remote,
+                         format_frame(SomfyFrame::build(command.command, code, remote)).c_str());
+                text += row;
+            }
+        }
+    }
+
+    expect_golden_text("frames.csv", text);
+}
+
+TEST(SomfyRemoteTest, TransmissionsMatchGolden) {
+    for (const auto& command : COMMANDS) {
+        for (const auto code : ROLLING_CODES) {
+            const auto frame = SomfyFrame::build(command.command, code, REMOTE);
+
+            char comment[160];
+            snprintf(comment, sizeof(comment),
+                     "%s, rolling code %u, remote %06X: the first frame and one repeat\nframe %s", command.name, code,
+                     REMOTE, format_frame(frame).c_str());
+
+            expect_golden_pulses(get_transmission_name(command, code), comment, record_transmission(frame, 1));
+        }
+    }
+}
+
+// The trains rendered for a transmitter, e.g. the RMT peripheral, must put the same pulses on the air as toggling a
+// pin does.
+TEST(SomfyRemoteTest, RenderedTrainsMatchGolden) {
+    for (const auto& command : COMMANDS) {
+        for (const auto code : ROLLING_CODES) {
+            RecordingTransmitter transmitter;
+            SomfyRemote remote(&transmitter, REMOTE, nullptr);
+            remote.sendCommandWithCode(command.command, code, 1);
+
+            for (const auto& train : transmitter.trains) {
+                // The RMT peripheral takes pairs of pulses and ends the transmission at a zero duration.
+                EXPECT_EQ(0u, train.size() % 2);
+                for (size_t i = 0; i < train.size(); i++) {
+                    EXPECT_GT(train[i].duration, 0u);
+                }
+            }
+
+            const auto name = get_transmission_name(command, code);
+            const auto expected = read_golden_pulses(name);
+            const auto pulses = merge_pulses(transmitter.get_pulses());
+            ASSERT_EQ(expected.size(), pulses.size()) << name;
+            for (size_t i = 0; i < expected.size(); i++) {
+                EXPECT_EQ(expected[i], pulses[i]) << name << " pulse " << i;
+            }
+        }
+    }
+}
+
+TEST(SomfyRemoteTest, RepeatsAddRepeatFrames) {
+    const auto frame = SomfyFrame::build(Command::Down, 0x1234, REMOTE);
+    const auto single = merge_pulses(record_transmission(frame, 1));
+
+    // The repeat frame starts after the silence following the first frame, which comes after the wake-up pulse.
+    size_t repeat_start = 0;
+    uint32_t repeat_duration_us = 0;
+    for (size_t i = 2; i < single.size(); i++) {
+        if (!single[i].level && single[i].duration_us > 30000) {
+            repeat_start = i + 1;
+            break;
+        }
+    }
+    ASSERT_GT(repeat_start, 0u);
+    for (size_t i = repeat_start; i < single.size(); i++) {
+        repeat_duration_us += single[i].duration_us;
+    }
+
+    for (int repeat = 0; repeat <= 8; repeat++) {
+        const auto pulses = merge_pulses(record_transmission(frame, repeat));
+
+        uint32_t duration_us = 0;
+        for (const auto& pulse : pulses) {
+            duration_us += pulse.duration_us;
+        }
+
+        EXPECT_EQ(SomfyRemote::getCommandDuration(repeat), duration_us) << "repeat " << repeat;
+        if (repeat >= 1) {
+            EXPECT_EQ(single.size() + (repeat - 1) * (single.size() - repeat_start), pulses.size())
+                << "repeat " << repeat;
+            EXPECT_EQ(single.back(), pulses.back()) << "repeat " << repeat;
+        }
+        EXPECT_EQ(duration_us, SomfyRemote::getCommandDuration(0) + repeat * repeat_duration_us)
+            << "repeat " << repeat;
+    }
+}
+
+TEST(SomfyRemoteTest, SyncVariants) {
+    const auto frame = SomfyFrame::build(Command::Up, 42, REMOTE);
+
+    for (const uint8_t sync : {2, 7}) {
+        SomfyRecorderOutput output;
+        SomfyRemote::sendFrame(output, frame.data, sync);
+        const auto pulses = merge_pulses(to_golden(output));
+
+        // Only the first frame has the wake-up pulse.
+        const size_t wake_up = sync == 2 ? 2 : 0;
+        ASSERT_GT(pulses.size(), wake_up + 2 * sync + 1);
+        if (wake_up) {
+            EXPECT_EQ((GoldenPulse{true, 9415}), pulses[0]);
+            EXPECT_EQ((GoldenPulse{false, 9565 + 80000}), pulses[1]);
+        }
+        for (uint8_t i = 0; i < sync; i++) {
+            EXPECT_EQ((GoldenPulse{true, 4 * 640}), pulses[wake_up + 2 * i]);
+            EXPECT_EQ((GoldenPulse{false, 4 * 640}), pulses[wake_up + 2 * i + 1]);
+        }
+        EXPECT_EQ((GoldenPulse{true, 4550}), pulses[wake_up + 2 * sync]);
+    }
+}
+
+TEST(SomfyRemoteTest, FullTrainReportsDroppedPulses) {
+    SomfyPulseTrain train;
+    for (size_t i = 0; i < SomfyPulseTrain::CAPACITY; i++) {
+        ASSERT_TRUE(train.append(i % 2 == 0, 640)) << "pulse " << i;
+    }
+
+    // Extending the last pulse still fits, a new one doesn't.
+    EXPECT_TRUE(train.append(false, 640));
+    EXPECT_FALSE(train.append(true, 640));
+    EXPECT_EQ(SomfyPulseTrain::CAPACITY, train.size());
+
+    // A pulse that must be split fails as well once the split off part doesn't fit.
+    train.clear();
+    for (size_t i = 0; i < SomfyPulseTrain::CAPACITY - 1; i++) {
+        train.append(i % 2 == 0, 640);
+    }
+    EXPECT_FALSE(train.append(true, 2 * SomfyPulseTrain::MAX_DURATION));
+}
+
+TEST(SomfyRemoteTest, FramesFitInTrain) {
+    const auto frame = SomfyFrame::build(Command::Up, 42, REMOTE);
+
+    for (const uint8_t sync : {2, 7}) {
+        SomfyPulseTrain train;
+        EXPECT_TRUE(SomfyRemote::renderFrame(frame.data, sync, train)) << "sync " << int(sync);
+        EXPECT_GT(train.size(), 0u);
+        EXPECT_TRUE(SomfyRemote::renderFrameBody(frame.data, sync, train)) << "sync " << int(sync);
+        EXPECT_GT(train.size(), 0u);
+    }
+
+    // More hardware syncs than fit in a train leave it empty instead of sending a truncated frame.
+    SomfyPulseTrain train;
+    EXPECT_FALSE(SomfyRemote::renderFrameBody(frame.data, SomfyPulseTrain::CAPACITY / 2, train));
+    EXPECT_EQ(0u, train.size());
+    EXPECT_FALSE(SomfyRemote::renderFrame(frame.data, SomfyPulseTrain::CAPACITY / 2, train));
+    EXPECT_EQ(0u, train.size());
+}
+
+TEST(SomfyRemoteTest, GetSomfyCommand) {
+    for (const auto& command : COMMANDS) {
+        string name;
+        // The names are matched without regard to case and underscores aren't part of them.
+        for (const char* c = command.name; *c; c++) {
+            if (*c != '_') {
+                name += *c;
+            }
+        }
+        EXPECT_EQ(command.command, getSomfyCommand(name.c_str())) << name;
+        EXPECT_EQ(command.command, getSomfyCommand(String(name.c_str()))) << name;
+    }
+
+    EXPECT_EQ(Command::Down, getSomfyCommand("DOWN"));
+    EXPECT_EQ(Command::Flag, getSomfyCommand("a"));
+    EXPECT_EQ(Command::Prog, getSomfyCommand("8"));
+    EXPECT_EQ(Command::My, getSomfyCommand("unknown"));
+}
+
+// A storage written before peekCode existed; it only implements nextCode.
+class CountingCodeStorage : public RollingCodeStorage {
+public:
+    uint16_t next = 0x1234;
+
+    uint16_t nextCode() override { return next++; }
+};
+
+TEST(SomfyRemoteTest, StorageWithoutPeekCode) {
+    CountingCodeStorage storage;
+    RecordingTransmitter transmitter;
+    SomfyRemote remote(&transmitter, REMOTE, &storage);
+
+    // Nothing can be rendered ahead of time, and doing so must not consume a rolling code.
+    remote.prepareCommand(Command::Up);
+    remote.prepare();
+    EXPECT_EQ(0x1234, storage.next);
+
+    remote.sendCommand(Command::Up, 1);
+    EXPECT_EQ(0x1235, storage.next);
+
+    const auto expected = read_golden_pulses(get_transmission_name(COMMANDS[1], 0x1234));
+    EXPECT_EQ(expected, merge_pulses(transmitter.get_pulses()));
+}
+
+// The done callback must only fire once the last train of a transmission has been queued.
+TEST(SomfyRemoteTest, AsyncTransmissionsAreFlushedOnce) {
+    CountingCodeStorage storage;
+    RecordingTransmitter transmitter;
+    int done = 0;
+    transmitter.setDoneCallback(
+        [](void* arg) {
+            (*static_cast<int*>(arg))++;
+            return false;
+        },
+        &done);
+
+    SomfyRemote remote(&transmitter, REMOTE, &storage);
+    remote.sendCommandAsync(Command::Down, 2);
+    EXPECT_EQ(1, transmitter.flushes);
+    EXPECT_EQ(1, done);
+
+    // The synchronous send waits for the transmission instead.
+    remote.sendCommand(Command::Up, 1);
+    EXPECT_EQ(1, transmitter.flushes);
+
+    CountingCodeStorage otherStorage;
+    SomfyRemote other(&transmitter, REMOTE + 1, &otherStorage);
+    SomfySession session(&transmitter, 10000);
+    session.add(remote, Command::My);
+    session.add(other, Command::My);
+    transmitter.trains.clear();
+    session.start();
+    EXPECT_EQ(2, transmitter.flushes);
+    EXPECT_EQ(2, done);
+    EXPECT_FALSE(transmitter.trains.empty());
+}
+
+// A storage that can't store its codes, e.g. because the flash can't be read.
+class FailingCodeStorage : public RollingCodeStorage {
+public:
+    uint16_t nextCode() override { return 1; }
+    bool tryReserveCodes(uint16_t, uint16_t&) override { return false; }
+};
+
+TEST(SomfyRemoteTest, NothingIsSentWithoutCode) {
+    FailingCodeStorage storage;
+    RecordingTransmitter transmitter;
+    int done = 0;
+    transmitter.setDoneCallback(
+        [](void* arg) {
+            (*static_cast<int*>(arg))++;
+            return false;
+        },
+        &done);
+
+    SomfyRemote remote(&transmitter, REMOTE, &storage);
+    EXPECT_FALSE(remote.sendCommand(Command::Up));
+    EXPECT_FALSE(remote.sendCommandAsync(Command::Up));
+    EXPECT_FALSE(remote.holdCommand(Command::Up, 1000, [] { return true; }));
+    EXPECT_EQ(nullptr, remote.renderNextCommand(Command::Up));
+
+    SomfySession session(&transmitter, 10000);
+    EXPECT_FALSE(session.add(remote, Command::Up));
+    EXPECT_EQ(0u, session.size());
+    session.start();
+
+    EXPECT_TRUE(transmitter.trains.empty());
+    EXPECT_EQ(0, done);
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "NVSRollingCodeStorage.h"
+#include "PartitionRollingCodeStorage.h"
+#include "WriteBehindRollingCodeStorage.h"
+
+using namespace std;
+
+static constexpr size_t SECTORS = 3;
+static constexpr size_t SECTOR_SIZE = 1024;
+static constexpr uint16_t RESERVE_AHEAD = 8;
+static constexpr size_t REMOTE_COUNT = 8;
+// Long enough that the flusher doesn't write while a test is taking codes.
+static constexpr uint32_t IDLE_MS = 20;
+
+static uint32_t get_remote(size_t index) { return 0x300000 + index; }
+
+// The task of a flusher never ends, so it's never deleted. The tests wait for it to be idle before the storages it
+// tops up go away.
+static RollingCodeFlusher* start_flusher(RollingCodeBatch* batch) {
+    const auto flusher = new RollingCodeFlusher(IDLE_MS, batch);
+    flusher->begin(1);
+    return flusher;
+}
+
+// Write-behind storages for a number of remotes, backed by a log.
+struct LoggedRemotes {
+    PartitionRollingCodeLog log{"codes"};
+    vector<unique_ptr<PartitionRollingCodeStorage>> backing;
+    vector<unique_ptr<WriteBehindRollingCodeStorage>> storages;
+
+    explicit LoggedRemotes(bool batched) {
+        EXPECT_TRUE(log.begin());
+
+        const auto flusher = start_flusher(batched ? &log : nullptr);
+        for (size_t i = 0; i < REMOTE_COUNT; i++) {
+            backing.push_back(make_unique<PartitionRollingCodeStorage>(&log, get_remote(i)));
+            storages.push_back(make_unique<WriteBehindRollingCodeStorage>(backing.back().get(), flusher, RESERVE_AHEAD));
+        }
+    }
+};
+
+class WriteBehindRollingCodeStorageTest : public testing::Test {
+protected:
+    void SetUp() override {
+        fakeFlash.format("codes", SECTORS, SECTOR_SIZE);
+        fakeNvs.reset();
+    }
+};
+
+TEST_F(WriteBehindRollingCodeStorageTest, CodesAreReservedAhead) {
+    NVSRollingCodeStorage backing("somfy", "remote");
+    WriteBehindRollingCodeStorage storage(&backing, start_flusher(nullptr), RESERVE_AHEAD);
+    ASSERT_TRUE(host_wait_until_idle());
+
+    // The flusher reserved the codes before the first one is taken.
+    const auto commits = fakeNvs.commits;
+    uint16_t stored;
+    ASSERT_TRUE(backing.peekCode(stored));
+    EXPECT_EQ(1 + RESERVE_AHEAD, stored);
+
+    for (uint16_t code = 1; code <= RESERVE_AHEAD / 2; code++) {
+        EXPECT_EQ(code, storage.nextCode());
+    }
+    EXPECT_EQ(commits, fakeNvs.commits);
+
+    // Using half of the reservation tops it up once the commands stop.
+    ASSERT_TRUE(host_wait_until_idle());
+    EXPECT_EQ(commits + 1, fakeNvs.commits);
+    ASSERT_TRUE(backing.peekCode(stored));
+    EXPECT_EQ(RESERVE_AHEAD / 2 + 1 + RESERVE_AHEAD, stored);
+}
+
+TEST_F(WriteBehindRollingCodeStorageTest, RunningOutReservesSynchronously) {
+    NVSRollingCodeStorage backing("somfy", "remote");
+    WriteBehindRollingCodeStorage storage(&backing, start_flusher(nullptr), RESERVE_AHEAD);
+    ASSERT_TRUE(host_wait_until_idle());
+
+    for (uint16_t code = 1; code <= 3 * RESERVE_AHEAD; code++) {
+        EXPECT_EQ(code, storage.nextCode());
+    }
+
+    uint16_t stored;
+    EXPECT_TRUE(backing.peekCode(stored));
+    EXPECT_GT(stored, 3 * RESERVE_AHEAD);
+
+    EXPECT_TRUE(host_wait_until_idle());
+}
+
+TEST_F(WriteBehindRollingCodeStorageTest, FlusherWritesEveryStorageWithoutBatch) {
+    LoggedRemotes remotes(false);
+    ASSERT_TRUE(host_wait_until_idle());
+
+    // Formatting the log wrote the header and the marker of an empty snapshot.
+    EXPECT_EQ(2 + REMOTE_COUNT, size_t(fakeFlash.writes));
+}
+
+TEST_F(WriteBehindRollingCodeStorageTest, FlusherBatchesWrites) {
+    LoggedRemotes remotes(true);
+    ASSERT_TRUE(host_wait_until_idle());
+
+    // After formatting the log, all remotes were reserved in one write.
+    EXPECT_EQ(3, fakeFlash.writes);
+    for (size_t i = 0; i < REMOTE_COUNT; i++) {
+        EXPECT_EQ(1 + RESERVE_AHEAD, remotes.log.get(get_remote(i)));
+    }
+
+    // A burst of commands for all remotes is topped up in one write too.
+    for (auto& storage : remotes.storages) {
+        for (uint16_t i = 0; i < RESERVE_AHEAD / 2; i++) {
+            storage->nextCode();
+        }
+    }
+    EXPECT_EQ(3, fakeFlash.writes);
+    ASSERT_TRUE(host_wait_until_idle());
+    EXPECT_EQ(4, fakeFlash.writes);
+    for (size_t i = 0; i < REMOTE_COUNT; i++) {
+        EXPECT_EQ(RESERVE_AHEAD / 2 + 1 + RESERVE_AHEAD, remotes.log.get(get_remote(i)));
+    }
+}
+
+// Takes codes and cuts the power at random points, including while the flusher writes. No code handed out before a
+// reset may come up again after it.
+TEST_F(WriteBehindRollingCodeStorageTest, NoCodeIsReusedAfterReset) {
+    // A fixed seed so a failure can be reproduced.
+    mt19937 random(0x3B17);
+    uniform_int_distribution<int64_t> cut(0, 400);
+    uniform_int_distribution<size_t> remote(0, REMOTE_COUNT - 1);
+    uniform_int_distribution<int> pause(0, 24);
+
+    vector<int> last_sent(REMOTE_COUNT, 0);
+    for (int boot = 0; boot < 20; boot++) {
+        const auto context = "boot " + to_string(boot);
+        fakeFlash.restore_power();
+
+        LoggedRemotes remotes(true);
+        ASSERT_TRUE(host_wait_until_idle()) << context;
+
+        fakeFlash.cut_power_after(cut(random));
+        for (int i = 0; i < 100; i++) {
+            const auto chosen = remote(random);
+            uint16_t code;
+            if (!remotes.storages[chosen]->tryReserveCodes(1, code)) {
+                // Without flash, nothing is sent anymore.
+                EXPECT_FALSE(fakeFlash.powered) << context;
+                break;
+            }
+            EXPECT_GT(code, last_sent[chosen]) << context << ": remote " << chosen;
+            if (HasFailure()) {
+                break;
+            }
+            last_sent[chosen] = code;
+
+            // Give the flusher a chance to write between some of the commands.
+            if (pause(random) == 0) {
+                this_thread::sleep_for(chrono::milliseconds(IDLE_MS + 10));
+            }
+        }
+        // The reset: the flusher may have been writing when the power went.
+        ASSERT_TRUE(host_wait_until_idle()) << context;
+        if (HasFailure()) {
+            return;
+        }
+    }
+}
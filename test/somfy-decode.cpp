@@ -0,0 +1,34 @@
+// Decodes the Somfy frames in a pulse list using SomfyDecoder, the decoder the firmware runs on received signals.
+// Reads level,duration_us rows from standard input and writes a frame,command,code,remote row for every valid
+// frame. Rows that aren't pulses, e.g. headers and comments, are skipped.
+
+#include <stdio.h>
+
+#include "SomfyDecoder.h"
+
+int main() {
+    SomfyDecoder decoder;
+    char line[256];
+
+    while (fgets(line, sizeof(line), stdin)) {
+        int level;
+        double duration_us;
+        if (sscanf(line, "%d,%lf", &level, &duration_us) != 2) {
+            continue;
+        }
+
+        if (!decoder.decode(level != 0, static_cast<uint32_t>(duration_us + 0.5))) {
+            continue;
+        }
+
+        const auto& frame = decoder.getFrame();
+        const auto& contents = decoder.getContents();
+
+        for (byte i = 0; i < SomfyFrame::SIZE; i++) {
+            printf(i ? " %02X" : "%02X", frame[i]);
+        }
+        printf(",%d,%u,%06X\n", static_cast<int>(contents.command), contents.code, contents.remote);
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core used by Somfy_Remote_Lib. Time is virtual: the delays advance the
+// clock instead of sleeping, so transmissions sent by toggling a pin complete instantly and deterministically.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define HEX 16
+
+inline std::atomic<uint64_t> hostMicros{0};
+
+inline unsigned long micros() { return hostMicros; }
+inline unsigned long millis() { return hostMicros / 1000; }
+inline void delayMicroseconds(uint32_t us) { hostMicros += us; }
+inline void delay(uint32_t ms) { hostMicros += uint64_t(ms) * 1000; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+class String {
+    std::string value;
+
+public:
+    String(const char* value = "") : value(value) {}
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+};
+
+struct HostSerial {
+    void print(const char* value) { fputs(value, stderr); }
+    void print(int value, int base = 10) { fprintf(stderr, base == HEX ? "%X" : "%d", value); }
+    void println(const char* value = "") { fprintf(stderr, "%s\n", value); }
+};
+
+inline HostSerial Serial;
@@ -0,0 +1,44 @@
+#pragma once
+
+// Host stand-in for the callbacks the firmware components raise their events with.
+
+#include <functional>
+#include <vector>
+
+#include "Queue.h"
+
+template <typename T>
+class Callback {
+    std::vector<std::function<void(T)>> _funcs;
+
+public:
+    void add(const std::function<void(T)>& func) { _funcs.push_back(func); }
+
+    void call(T value) {
+        for (const auto& func : _funcs) {
+            func(value);
+        }
+    }
+
+    void queue(Queue* queue, T value) {
+        queue->enqueue([this, value]() { call(value); });
+    }
+};
+
+template <>
+class Callback<void> {
+    std::vector<std::function<void()>> _funcs;
+
+public:
+    void add(const std::function<void()>& func) { _funcs.push_back(func); }
+
+    void call() {
+        for (const auto& func : _funcs) {
+            func();
+        }
+    }
+
+    void queue(Queue* queue) {
+        queue->enqueue([this]() { call(); });
+    }
+};
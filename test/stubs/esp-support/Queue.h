@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in for the queue of work that the application runs on its main task. The host program runs the queued
+// work by calling process.
+
+#include <functional>
+#include <vector>
+
+class Queue {
+    std::vector<std::function<void()>> _queue;
+
+public:
+    void enqueue(std::function<void()> func) { _queue.push_back(std::move(func)); }
+
+    void process() {
+        // Work queued while processing runs in the same call.
+        for (size_t i = 0; i < _queue.size(); i++) {
+            auto func = std::move(_queue[i]);
+            func();
+        }
+        _queue.clear();
+    }
+};
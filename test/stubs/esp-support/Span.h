@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in; the parts of the firmware built on the host don't use spans.
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <string>
+
+inline std::string strformat(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    const auto length = vsnprintf(nullptr, 0, format, copy);
+    va_end(copy);
+
+    std::string result(length, '\0');
+    vsnprintf(result.data(), length + 1, format, args);
+    va_end(args);
+    return result;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    char version[32];
+    char project_name[32];
+} esp_app_desc_t;
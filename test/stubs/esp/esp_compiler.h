@@ -0,0 +1,7 @@
+#pragma once
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+// The name newlib gives the function an assertion failed in.
+#define __ASSERT_FUNC __PRETTY_FUNCTION__
@@ -0,0 +1,36 @@
+#pragma once
+
+// Host stand-in for the HTTP client. Nothing is downloaded or uploaded on the host; every request fails to connect.
+// Also brings in what the real header pulls in through lwIP and esp_system.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "esp_err.h"
+#include "esp_system.h"
+
+// lwIP's, which the firmware gets through this header.
+#define ERR_OK 0
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct {
+    const char* url;
+    int timeout_ms;
+} esp_http_client_config_t;
+
+typedef struct esp_http_client* esp_http_client_handle_t;
+
+inline esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t*) { return nullptr; }
+inline esp_err_t esp_http_client_set_header(esp_http_client_handle_t, const char*, const char*) { return ESP_OK; }
+inline esp_err_t esp_http_client_set_method(esp_http_client_handle_t, esp_http_client_method_t) { return ESP_OK; }
+inline esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t, const char*, int) { return ESP_OK; }
+inline esp_err_t esp_http_client_open(esp_http_client_handle_t, int) { return ESP_FAIL; }
+inline esp_err_t esp_http_client_perform(esp_http_client_handle_t) { return ESP_FAIL; }
+inline int64_t esp_http_client_fetch_headers(esp_http_client_handle_t) { return -ESP_FAIL; }
+inline int esp_http_client_read(esp_http_client_handle_t, char*, int) { return -ESP_FAIL; }
+inline esp_err_t esp_http_client_close(esp_http_client_handle_t) { return ESP_OK; }
+inline esp_err_t esp_http_client_cleanup(esp_http_client_handle_t) { return ESP_OK; }
@@ -0,0 +1,33 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF log. Messages at or below hostLogLevel go to stderr; the default drops them all, so
+// tests that overflow queues on purpose don't flood the output.
+
+#include <inttypes.h>
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+inline esp_log_level_t hostLogLevel = ESP_LOG_NONE;
+
+#define HOST_LOG(level, letter, tag, format, ...)                               \
+    do {                                                                        \
+        if (hostLogLevel >= (level)) {                                          \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__); \
+        }                                                                       \
+    } while (0)
+
+inline void esp_log_level_set(const char*, esp_log_level_t) {}
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
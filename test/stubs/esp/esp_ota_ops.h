@@ -0,0 +1,20 @@
+#pragma once
+
+// Host stand-in that describes the running application as a host build.
+
+#include <string.h>
+
+#include "esp_app_format.h"
+#include "esp_partition.h"
+
+inline const esp_partition_t* esp_ota_get_running_partition() {
+    static const esp_partition_t running = {0, 0, "factory"};
+    return &running;
+}
+
+inline esp_err_t esp_ota_get_partition_description(const esp_partition_t*, esp_app_desc_t* app_desc) {
+    *app_desc = {};
+    strcpy(app_desc->version, "host");
+    strcpy(app_desc->project_name, "somfy-remote");
+    return ESP_OK;
+}
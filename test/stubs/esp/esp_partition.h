@@ -0,0 +1,142 @@
+#pragma once
+
+// Host stand-in for a data partition on NOR flash. Like real flash, an erase sets every byte of a sector to 0xFF and
+// a write can only clear bits. The power can be cut after a number of bytes: the write or erase in progress is torn
+// halfway through its current byte, and nothing written after the cut reaches the flash, like on a board that lost
+// power. Restoring the power models the reboot.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef enum { ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    uint32_t size;
+    uint32_t erase_size;
+    const char* label;
+} esp_partition_t;
+
+struct FakeFlash {
+    esp_partition_t partition = {0, 0, nullptr};
+    std::string label;
+    std::vector<uint8_t> data;
+    int writes = 0;
+    std::vector<int> erases;
+    // Bytes written and erased so far, which bounds the points the power can be cut at.
+    int64_t bytes = 0;
+    // Bytes that can still be written or erased before the power is cut; negative while it isn't going to be cut.
+    int64_t budget = -1;
+    // The budget armed once the next erase completes, to cut the power while a sector is being started.
+    int64_t budget_after_erase = -1;
+    bool powered = true;
+
+    void format(const char* label, size_t sectors, size_t sector_size) {
+        this->label = label;
+        partition = {uint32_t(sectors * sector_size), uint32_t(sector_size), this->label.c_str()};
+        data.assign(sectors * sector_size, 0xFF);
+        writes = 0;
+        erases.assign(sectors, 0);
+        bytes = 0;
+        restore_power();
+    }
+
+    void cut_power_after(int64_t bytes) { budget = bytes; }
+
+    void cut_power_after_next_erase(int64_t bytes) { budget_after_erase = bytes; }
+
+    void restore_power() {
+        budget = -1;
+        budget_after_erase = -1;
+        powered = true;
+    }
+
+    // How many of the next length bytes make it to the flash; cuts the power when the budget runs out.
+    size_t consume(size_t length) {
+        if (!powered) {
+            return 0;
+        }
+        if (budget < 0 || int64_t(length) <= budget) {
+            if (budget >= 0) {
+                budget -= length;
+            }
+            bytes += length;
+            return length;
+        }
+
+        const auto done = size_t(budget);
+        budget = 0;
+        powered = false;
+        bytes += done;
+        return done;
+    }
+};
+
+inline FakeFlash fakeFlash;
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t,
+                                                       const char* label) {
+    if (fakeFlash.data.empty() || fakeFlash.label != label) {
+        return nullptr;
+    }
+    return &fakeFlash.partition;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(dst, fakeFlash.data.data() + offset, size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const auto bytes = static_cast<const uint8_t*>(src);
+    const auto powered = fakeFlash.powered;
+    const auto done = fakeFlash.consume(size);
+    for (size_t i = 0; i < done; i++) {
+        fakeFlash.data[offset + i] &= bytes[i];
+    }
+    if (done < size) {
+        if (powered) {
+            // The byte being programmed when the power went only got its high bits.
+            fakeFlash.data[offset + done] &= bytes[done] | 0x0F;
+        }
+        return ESP_FAIL;
+    }
+
+    fakeFlash.writes++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (offset + size > partition->size || offset % partition->erase_size || size % partition->erase_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const auto done = fakeFlash.consume(size);
+    memset(fakeFlash.data.data() + offset, 0xFF, done);
+    if (done < size) {
+        return ESP_FAIL;
+    }
+
+    for (size_t sector = offset / partition->erase_size; sector < (offset + size) / partition->erase_size; sector++) {
+        fakeFlash.erases[sector]++;
+    }
+    if (fakeFlash.budget_after_erase >= 0) {
+        fakeFlash.cut_power_after(fakeFlash.budget_after_erase);
+        fakeFlash.budget_after_erase = -1;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// The CRC-16/CCITT variant of the ROM: reflected, with the CRC inverted on the way in and out.
+inline uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+inline uint32_t esp_get_free_heap_size() { return 256 * 1024; }
+inline uint32_t esp_get_minimum_free_heap_size() { return 256 * 1024; }
+
+// A fixed sequence, so remotes created by tests get the same IDs on every run.
+inline uint32_t esp_random() {
+    static uint32_t state = 0x50F7;
+    state = state * 1664525 + 1013904223;
+    return state;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Host stand-in for esp_timer. It reads the virtual clock of the Arduino stand-in, so the firmware and the library
+// share one time that only moves when a test or a transmission moves it.
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return hostMicros; }
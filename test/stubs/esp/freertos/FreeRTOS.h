@@ -0,0 +1,63 @@
+#pragma once
+
+// Host stand-in for the parts of FreeRTOS the firmware uses, built on the C++ standard library. Tasks are threads,
+// a tick is a millisecond of real time, and nothing runs in an interrupt.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR(...)
+
+inline BaseType_t xPortInIsrContext() { return pdFALSE; }
+
+// Waits until ready returns true or the ticks run out. Waiting forever is done in slices, because the untimed
+// condition_variable::wait needs a newer libstdc++ than the one some GoogleTest packages link against.
+template <typename Ready>
+bool host_wait(std::condition_variable& condition, std::unique_lock<std::mutex>& lock, TickType_t ticks, Ready ready) {
+    if (ticks != portMAX_DELAY) {
+        return condition.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+    }
+    while (!condition.wait_for(lock, std::chrono::hours(1), ready)) {
+    }
+    return true;
+}
+
+// Tasks started with xTaskCreate that aren't waiting for a semaphore or a notification without a timeout. A give
+// makes the task it wakes busy right away, so once this drops to zero, nothing happens until a test acts again.
+inline std::atomic<int> hostBusyTasks{0};
+
+// Whether the calling thread was started with xTaskCreate.
+inline bool& host_is_task() {
+    thread_local bool task = false;
+    return task;
+}
+
+// Waits until all tasks are waiting for something a test has to do, e.g. queue a command. Returns false when that
+// takes longer than the timeout.
+inline bool host_wait_until_idle(std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (hostBusyTasks > 0) {
+        if (std::chrono::steady_clock::now() > end) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
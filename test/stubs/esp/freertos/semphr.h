@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+struct HostSemaphore {
+    std::mutex lock;
+    std::condition_variable available;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    bool mutex;
+    // Tasks waiting without a timeout, which count as idle. A give hands the count back to one of them, so this
+    // assumes that no other task takes the semaphore while they wait, as with the semaphores that wake a task.
+    int idle_waiters;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    const auto semaphore = new HostSemaphore();
+    semaphore->count = initial_count;
+    semaphore->max_count = max_count;
+    semaphore->mutex = false;
+    semaphore->idle_waiters = 0;
+    return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return xSemaphoreCreateCounting(1, 0); }
+
+// Without priority inheritance or an owner; the firmware only takes and gives a mutex in the same task.
+// Waiting for a mutex doesn't make a task idle, because the holder is busy.
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    const auto semaphore = xSemaphoreCreateCounting(1, 1);
+    semaphore->mutex = true;
+    return semaphore;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+
+    const auto ready = [semaphore] { return semaphore->count > 0; };
+    if (ticks == portMAX_DELAY && !ready() && !semaphore->mutex && host_is_task()) {
+        semaphore->idle_waiters++;
+        hostBusyTasks--;
+    }
+    if (!host_wait(semaphore->available, lock, ticks, ready)) {
+        return pdFALSE;
+    }
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->lock);
+
+    if (semaphore->count == semaphore->max_count) {
+        return pdFALSE;
+    }
+
+    semaphore->count++;
+    if (semaphore->idle_waiters) {
+        semaphore->idle_waiters--;
+        hostBusyTasks++;
+    }
+    semaphore->available.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higher_priority_task_woken) {
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
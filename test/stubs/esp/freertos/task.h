@@ -0,0 +1,87 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+
+struct HostTask {
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+    // Waiting for a notification without a timeout, which makes the task idle.
+    bool idle = false;
+};
+
+typedef HostTask* TaskHandle_t;
+
+inline TaskHandle_t& host_current_task() {
+    thread_local TaskHandle_t task = nullptr;
+    return task;
+}
+
+// The task of the calling thread. Threads that weren't started with xTaskCreate, e.g. the one running the tests,
+// get one on first use.
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    auto& task = host_current_task();
+    if (!task) {
+        task = new HostTask();
+    }
+    return task;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char*, uint32_t, void* arg, UBaseType_t,
+                              TaskHandle_t* handle) {
+    const auto task = new HostTask();
+    if (handle) {
+        *handle = task;
+    }
+
+    // Tasks never return, so the thread is left running until the process exits.
+    hostBusyTasks++;
+    std::thread([function, arg, task] {
+        host_is_task() = true;
+        host_current_task() = task;
+        function(arg);
+    }).detach();
+
+    return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    const auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+
+    const auto ready = [task] { return task->notifications > 0; };
+    if (ticks == portMAX_DELAY && !ready() && host_is_task()) {
+        task->idle = true;
+        hostBusyTasks--;
+    }
+    if (!host_wait(task->notified, lock, ticks, ready)) {
+        return 0;
+    }
+
+    const auto result = task->notifications;
+    task->notifications = clear_on_exit ? 0 : result - 1;
+    return result;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->lock);
+
+    task->notifications++;
+    if (task->idle) {
+        task->idle = false;
+        hostBusyTasks++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higher_priority_task_woken) {
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    xTaskNotifyGive(task);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for the GPIO registers SomfyGPIORegisterOutput writes. The host has no pins.
+
+#include <stdint.h>
+
+typedef struct {
+} gpio_dev_t;
+
+inline gpio_dev_t GPIO;
+
+inline void gpio_ll_set_level(gpio_dev_t*, uint32_t, uint32_t) {}
@@ -0,0 +1,175 @@
+#pragma once
+
+// Host stand-in for the ESP-MQTT client. Nothing goes on the network: the client keeps the event handler the
+// firmware registers, so a host program can deliver events to it like the MQTT task does, and it counts what the
+// firmware publishes.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id,
+                                    void* event_data);
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+    MQTT_ERROR_TYPE_SUBSCRIBE_FAILED,
+} esp_mqtt_error_type_t;
+
+typedef enum {
+    MQTT_PROTOCOL_UNDEFINED = 0,
+    MQTT_PROTOCOL_V_3_1,
+    MQTT_PROTOCOL_V_3_1_1,
+    MQTT_PROTOCOL_V_5,
+} esp_mqtt_protocol_ver_t;
+
+typedef struct {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    esp_mqtt_error_type_t error_type;
+    int connect_return_code;
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char* data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char* topic;
+    int topic_len;
+    int msg_id;
+    esp_mqtt_error_codes_t* error_handle;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+// The fields the firmware sets, in the order of the real configuration.
+typedef struct {
+    struct {
+        struct {
+            const char* uri;
+        } address;
+    } broker;
+    struct {
+        const char* username;
+        struct {
+            const char* password;
+        } authentication;
+    } credentials;
+    struct {
+        struct {
+            const char* topic;
+            const char* msg;
+            int qos;
+            int retain;
+        } last_will;
+        esp_mqtt_protocol_ver_t protocol_ver;
+    } session;
+    struct {
+        bool disable_auto_reconnect;
+    } network;
+    struct {
+        int size;
+    } buffer;
+} esp_mqtt_client_config_t;
+
+typedef struct {
+    uint32_t session_expiry_interval;
+    uint32_t maximum_packet_size;
+    uint16_t receive_maximum;
+    uint16_t topic_alias_maximum;
+    bool request_resp_info;
+    bool request_problem_info;
+    uint32_t will_delay_interval;
+    uint32_t message_expiry_interval;
+    bool payload_format_indicator;
+} esp_mqtt5_connection_property_config_t;
+
+struct esp_mqtt_client {
+    esp_event_handler_t handler;
+    void* handler_arg;
+};
+
+struct FakeMqtt {
+    esp_mqtt_client client{};
+    // The topic of the last subscription, e.g. the command topics of the device.
+    std::string subscription;
+    int published = 0;
+    size_t published_bytes = 0;
+
+    void reset() {
+        client = {};
+        subscription.clear();
+        published = 0;
+        published_bytes = 0;
+    }
+
+    void dispatch(esp_mqtt_event_id_t event_id, std::string_view topic = {}, std::string_view data = {}) {
+        esp_mqtt_event_t event{};
+        event.event_id = event_id;
+        event.client = &client;
+        event.data = const_cast<char*>(data.data());
+        event.data_len = int(data.size());
+        event.total_data_len = event.data_len;
+        event.topic = const_cast<char*>(topic.data());
+        event.topic_len = int(topic.size());
+
+        client.handler(client.handler_arg, "MQTT_EVENTS", event_id, &event);
+    }
+};
+
+inline FakeMqtt fakeMqtt;
+
+inline esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t*) { return &fakeMqtt.client; }
+
+inline esp_err_t esp_mqtt5_client_set_connect_property(esp_mqtt_client_handle_t,
+                                                       const esp_mqtt5_connection_property_config_t*) {
+    return ESP_OK;
+}
+
+inline esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t,
+                                                esp_event_handler_t handler, void* handler_arg) {
+    client->handler = handler;
+    client->handler_arg = handler_arg;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t) { return ESP_OK; }
+
+inline int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t, const char* topic, int) {
+    fakeMqtt.subscription = topic;
+    return 0;
+}
+
+inline int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t, const char*) { return 0; }
+
+inline int esp_mqtt_client_publish(esp_mqtt_client_handle_t, const char*, const char* data, int len, int, int) {
+    fakeMqtt.published++;
+    fakeMqtt.published_bytes += len ? len : strlen(data);
+    return fakeMqtt.published;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+// Host stand-in for NVS. Entries are kept in memory and every access is counted, so tests can check how often code
+// writes to flash. Errors can be injected for opening namespaces and for the reads and writes of single keys.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+struct FakeNvs {
+    // Keyed by namespace and key, separated by a slash.
+    std::map<std::string, std::vector<uint8_t>> entries;
+    // Handle minus one.
+    std::vector<std::string> namespaces;
+    int opens = 0;
+    int closes = 0;
+    int reads = 0;
+    int writes = 0;
+    int commits = 0;
+    // Injected errors, keyed by namespace.
+    std::map<std::string, esp_err_t> open_errors;
+    // Injected errors, keyed like the entries.
+    std::map<std::string, esp_err_t> read_errors;
+    std::map<std::string, esp_err_t> write_errors;
+
+    void reset() { *this = {}; }
+
+    std::string get_name(nvs_handle_t handle, const char* key) const {
+        return namespaces.at(handle - 1) + "/" + key;
+    }
+
+    esp_err_t get(nvs_handle_t handle, const char* key, void* value, size_t* length, bool exact) {
+        reads++;
+
+        const auto name = get_name(handle, key);
+        const auto error = read_errors.find(name);
+        if (error != read_errors.end()) {
+            return error->second;
+        }
+
+        const auto entry = entries.find(name);
+        if (entry == entries.end()) {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+
+        const auto& data = entry->second;
+        if (exact ? data.size() != *length : data.size() > *length) {
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+
+        memcpy(value, data.data(), data.size());
+        *length = data.size();
+        return ESP_OK;
+    }
+
+    esp_err_t set(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+        writes++;
+
+        const auto name = get_name(handle, key);
+        const auto error = write_errors.find(name);
+        if (error != write_errors.end()) {
+            return error->second;
+        }
+
+        const auto bytes = static_cast<const uint8_t*>(value);
+        entries[name].assign(bytes, bytes + length);
+        return ESP_OK;
+    }
+};
+
+inline FakeNvs fakeNvs;
+
+inline esp_err_t nvs_open(const char* name, nvs_open_mode_t, nvs_handle_t* handle) {
+    const auto error = fakeNvs.open_errors.find(name);
+    if (error != fakeNvs.open_errors.end()) {
+        return error->second;
+    }
+
+    fakeNvs.opens++;
+    // Handles of a namespace are interchangeable, so a namespace that is opened over and over takes one handle.
+    const auto known = std::find(fakeNvs.namespaces.begin(), fakeNvs.namespaces.end(), name);
+    if (known == fakeNvs.namespaces.end()) {
+        fakeNvs.namespaces.push_back(name);
+        *handle = fakeNvs.namespaces.size();
+    } else {
+        *handle = known - fakeNvs.namespaces.begin() + 1;
+    }
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t) { fakeNvs.closes++; }
+
+inline esp_err_t nvs_commit(nvs_handle_t) {
+    fakeNvs.commits++;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_u16(nvs_handle_t handle, const char* key, uint16_t* value) {
+    size_t length = sizeof(*value);
+    return fakeNvs.get(handle, key, value, &length, true);
+}
+
+inline esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* value) {
+    size_t length = sizeof(*value);
+    return fakeNvs.get(handle, key, value, &length, true);
+}
+
+inline esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* value, size_t* length) {
+    return fakeNvs.get(handle, key, value, length, false);
+}
+
+inline esp_err_t nvs_set_u16(nvs_handle_t handle, const char* key, uint16_t value) {
+    return fakeNvs.set(handle, key, &value, sizeof(value));
+}
+
+inline esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return fakeNvs.set(handle, key, &value, sizeof(value));
+}
+
+inline esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return fakeNvs.set(handle, key, value, length);
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "nvs.h"
+
+inline esp_err_t nvs_flash_init() { return ESP_OK; }
@@ -0,0 +1,25 @@
+#pragma once
+
+// The project configuration for the host build: the defaults from sdkconfig, with two radios so the tests cover
+// the radios transmitting side by side. The receiver is off, the host has no pins to listen on, and rolling codes go
+// straight to the remote table in NVS.
+
+#define CONFIG_DEVICE_CONFIG_ENDPOINT "http://localhost/esp32/config/%s.json"
+#define CONFIG_DEVICE_GDO0_PIN 4
+#define CONFIG_DEVICE_GDO1_PIN 6
+#define CONFIG_DEVICE_GDO2_PIN 12
+#define CONFIG_DEVICE_SCK_PIN 5
+#define CONFIG_DEVICE_CSN_PIN 14
+#define CONFIG_DEVICE_MOSI_PIN 13
+#define CONFIG_DEVICE_TX_BACKEND_RMT 1
+#define CONFIG_DEVICE_RADIO_COUNT 2
+#define CONFIG_DEVICE_RADIO1_CSN_PIN 15
+#define CONFIG_DEVICE_RADIO1_GDO0_PIN 16
+#define CONFIG_DEVICE_COMMAND_DEADLINE_MS 5000
+#define CONFIG_DEVICE_HOLD_DEADLINE_MS 2000
+#define CONFIG_DEVICE_COMMAND_QUEUE_DEPTH 16
+#define CONFIG_DEVICE_COMMAND_QUEUE_OVERFLOW_COALESCE 1
+#define CONFIG_DEVICE_ROLLING_CODE_BLOCK 32
+
+#define CONFIG_ESP_MAIN_TASK_STACK_SIZE 3584
+#define CONFIG_OTA_RECV_TIMEOUT 15000
@@ -0,0 +1,5 @@
+#pragma once
+
+// What scripts/generate-secrets.py generates, without the secrets.
+
+#define CONFIG_WIFI_PASSWORD ""
@@ -0,0 +1,3 @@
+#pragma once
+
+// The host build transmits through the RMT stand-in; the CC1101 FIFO backend needs the radio.
@@ -0,0 +1,76 @@
+#pragma once
+
+// Host stand-in for the CC1101 driver. It keeps the state of every module as the firmware sets it through the
+// selected module, so tests can check which radio is transmitting.
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+
+typedef uint8_t byte;
+
+class ELECHOUSE_CC1101 {
+public:
+    enum class Mode { Idle, Tx, Rx };
+
+    struct Module {
+        byte ss_pin;
+        byte gdo0_pin;
+        bool initialized;
+        float mhz;
+        Mode mode;
+    };
+
+private:
+    mutable std::mutex _lock;
+    std::map<byte, Module> _modules;
+    byte _selected = 0;
+
+public:
+    void reset() {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules.clear();
+        _selected = 0;
+    }
+
+    Module get_module(byte modul) const {
+        std::lock_guard<std::mutex> lock(_lock);
+        const auto it = _modules.find(modul);
+        return it == _modules.end() ? Module{} : it->second;
+    }
+
+    void setGDO(byte, byte) {}
+    void addSpiPin(byte, byte, byte, byte ss, byte modul) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules[modul].ss_pin = ss;
+    }
+    void addGDO0(byte gdo0, byte modul) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules[modul].gdo0_pin = gdo0;
+    }
+    void setModul(byte modul) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _selected = modul;
+    }
+    bool Init() {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules[_selected].initialized = true;
+        return true;
+    }
+    void setMHZ(float mhz) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules[_selected].mhz = mhz;
+    }
+    void SetTx() { set_mode(Mode::Tx); }
+    void SetRx() { set_mode(Mode::Rx); }
+    void setSidle() { set_mode(Mode::Idle); }
+
+private:
+    void set_mode(Mode mode) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _modules[_selected].mode = mode;
+    }
+};
+
+inline ELECHOUSE_CC1101 ELECHOUSE_cc1101;
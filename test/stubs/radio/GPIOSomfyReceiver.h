@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for the receiver, which the host configuration leaves disabled. Nothing is ever received.
+
+#include "SomfyFrame.h"
+
+class GPIOSomfyReceiver {
+public:
+    explicit GPIOSomfyReceiver(uint8_t) {}
+
+    void setup() {}
+    void setEnabled(bool) {}
+    bool poll(SomfyFrameContents&) { return false; }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+// Host stand-in for the RMT transmitter, which is the radio of the host tests. Instead of clocking out the pulses, it
+// decodes them, so tests see the frames that went on the air, and it moves the virtual clock on by their duration.
+// Transmissions complete as soon as they're flushed. A test can keep a radio busy: while the transmitter is held,
+// transmit blocks until the test releases it. A task blocked that way counts as idle, so a test can wait for the
+// other radios to finish.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "Arduino.h"
+#include "SomfyDecoder.h"
+#include "SomfyTransmitter.h"
+#include "freertos/FreeRTOS.h"
+
+class RMTSomfyTransmitter : public SomfyTransmitter {
+public:
+    struct SentFrame {
+        SomfyFrameContents contents;
+        // Virtual time at which the frame ended.
+        uint64_t time_us;
+    };
+
+    // Every transmitter in the order they were created, which is the order of the radios.
+    inline static std::vector<RMTSomfyTransmitter*> instances;
+
+private:
+    // Long enough for any test, short enough that a test that forgets to release a radio fails instead of hanging.
+    static constexpr auto TIMEOUT = std::chrono::seconds(5);
+
+    std::mutex _lock;
+    std::condition_variable _changed;
+    int _pin;
+    SomfyDecoder _decoder;
+    // The pulse being sent, which continues when the next one has the same level.
+    bool _level{};
+    uint32_t _duration{};
+    std::vector<SentFrame> _frames;
+    bool _held{};
+    bool _blocked{};
+    bool _woken{};
+    DoneCallback _done_callback{};
+    void* _done_arg{};
+
+public:
+    explicit RMTSomfyTransmitter(int pin) : _pin(pin) { instances.push_back(this); }
+
+    int get_pin() const { return _pin; }
+
+    void setup() override {}
+
+    void transmit(const SomfyPulseTrain& train) override {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        if (_held) {
+            _blocked = true;
+            hostBusyTasks--;
+            _changed.notify_all();
+
+            // Released tasks are counted as busy by release, before they run again.
+            if (!_changed.wait_for(lock, TIMEOUT, [this] { return _woken; })) {
+                _blocked = false;
+                hostBusyTasks++;
+            }
+            _woken = false;
+        }
+
+        for (size_t i = 0; i < train.size(); i++) {
+            const bool level = train[i].level != 0;
+            if (level != _level) {
+                end_pulse();
+                _level = level;
+            }
+            _duration += train[i].duration;
+            hostMicros += train[i].duration;
+        }
+    }
+
+    void flush() override {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            end_pulse();
+        }
+
+        if (_done_callback) {
+            _done_callback(_done_arg);
+        }
+    }
+
+    void wait() override {
+        std::lock_guard<std::mutex> lock(_lock);
+        end_pulse();
+    }
+
+    void setDoneCallback(DoneCallback callback, void* arg) override {
+        _done_callback = callback;
+        _done_arg = arg;
+    }
+
+    void hold() {
+        std::lock_guard<std::mutex> lock(_lock);
+        _held = true;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(_lock);
+        _held = false;
+        if (_blocked) {
+            _blocked = false;
+            _woken = true;
+            hostBusyTasks++;
+            _changed.notify_all();
+        }
+    }
+
+    // Waits until a task is blocked in transmit while the transmitter is held. Returns false on a timeout.
+    bool wait_until_blocked() {
+        std::unique_lock<std::mutex> lock(_lock);
+        return _changed.wait_for(lock, TIMEOUT, [this] { return _blocked; });
+    }
+
+    std::vector<SentFrame> get_frames() {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _frames;
+    }
+
+private:
+    // Called with _lock held.
+    void end_pulse() {
+        if (!_duration) {
+            return;
+        }
+
+        if (_decoder.decode(_level, _duration)) {
+            _frames.push_back({_decoder.getContents(), hostMicros});
+        }
+        _duration = 0;
+    }
+};